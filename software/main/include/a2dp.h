@@ -4,4 +4,7 @@
 namespace a2dp {
 	void init();
 	void connect_to_last();
+
+	// Last delay that was reported to the phone, zero if it did not accept it
+	uint32_t get_reported_delay_us();
 }
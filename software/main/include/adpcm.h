@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "riff.h"
+
+// Streaming decoder for IMA-ADPCM wav files, decodes straight from the data chunk
+namespace adpcm {
+	class Decoder {
+		public:
+			// The wave has to be a valid IMA-ADPCM file
+			void open(const riff::Wave& wave);
+
+			uint32_t remaining() const { return samples; }
+
+			// Decodes up to length samples straight into stereo frames, returns the amount of frames produced
+			// Mono is played on both channels, anything past the first two channels is skipped
+			size_t decode(uint32_t* frames, size_t length);
+
+		private:
+			struct Channel {
+				int32_t predictor;
+				int32_t index;
+			};
+
+			int16_t expand(Channel& channel, uint8_t nibble);
+
+			const uint8_t* block = nullptr;
+			uint32_t samples = 0;
+			uint16_t samples_per_block = 0;
+			uint16_t block_align = 0;
+			uint16_t channels = 0;
+
+			// Position within the current block
+			uint16_t position = 0;
+			Channel state[2] = {};
+	};
+}
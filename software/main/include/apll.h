@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Smallest change of the clock that is worth reprogramming the APLL for, its resolution is about 1 ppm
+#define APLL_STEP_PPM 2
+
+// Steers the clock of i2s with the fractional divider of the APLL, so the drift between the phone and us is absorbed without resampling
+namespace apll {
+	// Rounds the ratio of the drift controller to whole steps, with a step of hysteresis so it does not toggle between two of them
+	class Trim {
+		public:
+			// True when the clock has to be reprogrammed
+			bool update(float ratio) {
+				float exact = (ratio - 1.f) * 1e6f;
+				if (std::fabs(exact - ppm) < APLL_STEP_PPM) {
+					return false;
+				}
+
+				ppm = lrintf(exact / APLL_STEP_PPM) * APLL_STEP_PPM;
+				return true;
+			}
+
+			void reset() { ppm = 0; }
+
+			int32_t get_ppm() const { return ppm; }
+			float get_ratio() const { return 1.f + ppm * 1e-6f; }
+
+		private:
+			int32_t ppm = 0;
+	};
+
+	// Takes over the clock after the i2s driver set it up for the rate, false if the APLL can not be used for it
+	bool start(uint32_t sample_rate);
+	// Runs i2s faster by the ratio, in whole steps
+	void trim(float ratio);
+	int32_t get_ppm();
+}
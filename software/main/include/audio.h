@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "eq.h"
+
+// Processing between the mixer and i2s, see dsp.h for the stages
+namespace audio {
+	struct Stats {
+		// Time from the mute request until the last audible frame left i2s
+		uint32_t mute_latency_us;
+		uint32_t mute_latency_max_us;
+		uint32_t mutes;
+
+		// Cost of the chain for the last block, the max is since the previous call
+		uint32_t cycles;
+		uint32_t cycles_max;
+		uint32_t frames;
+		// Delay added by the chain, the look ahead of the limiter
+		uint32_t latency_us;
+		// Most the limiter had to turn the signal down since the previous call
+		float limiter_reduction_db;
+	};
+
+	// Applies the settings from menuconfig
+	void init();
+
+	// Runs the chain over the block in place, only called from the i2s task
+	void process(uint32_t* frames, size_t length, uint32_t sample_rate);
+
+	// Fades out within a few milliseconds and back in when unmuted
+	void set_muted(bool muted);
+
+	// Linear gain, ramped in over the next block
+	void set_gain(float gain);
+	// Crossfades to the new equalizer preset
+	void set_preset(eq::Preset preset);
+	// Volume step of the radio (0-30), the loudness compensation follows it
+	void set_radio_volume(uint8_t volume);
+
+	// Delay the chain adds, the look ahead of the limiter
+	uint32_t get_latency_us();
+
+	Stats get_stats();
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// The ESP32 cache line size, keeps data that is written by different tasks from sharing a line
+#define CACHE_LINE_SIZE 32
@@ -1,19 +1,47 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <cassert>
 
 #define RADIO_ID 0x165
 #define VOLUME_ID 0x1A5
 #define BUTTONS_ID 0x21f
 
+// Every message is described by the position of its fields in the payload, instead of a packed bitfield struct
+// that depends on how the compiler lays it out, decode and encode are plain shifts and masks
 namespace can {
-	template <typename T>
-	static T convert(uint8_t* buf, uint8_t len) {
-		// @TODO Handle errors in a more elegant manner
-		assert(len == sizeof(T));
+	// Bits are counted from the least significant bit of the first byte
+	struct Field {
+		uint8_t offset;
+		uint8_t width;
+	};
+
+	constexpr uint32_t mask(Field field) {
+		return (1u << field.width) - 1;
+	}
+
+	// With the field known at compile time the loops unroll into a few loads and shifts
+	constexpr uint32_t get(const uint8_t* data, Field field) {
+		uint8_t first = field.offset / 8;
+		uint8_t last = (field.offset + field.width - 1) / 8;
 
-		return *(T*)buf;
+		uint32_t raw = 0;
+		for (uint8_t i = first; i <= last; i++) {
+			raw |= (uint32_t)data[i] << ((i - first) * 8);
+		}
+		return (raw >> (field.offset % 8)) & mask(field);
+	}
+
+	constexpr void set(uint8_t* data, Field field, uint32_t value) {
+		uint8_t first = field.offset / 8;
+		uint8_t last = (field.offset + field.width - 1) / 8;
+
+		uint32_t bits = (value & mask(field)) << (field.offset % 8);
+		uint32_t keep = ~(mask(field) << (field.offset % 8));
+		for (uint8_t i = first; i <= last; i++) {
+			uint8_t shift = (i - first) * 8;
+			data[i] = (data[i] & (keep >> shift)) | (bits >> shift);
+		}
 	}
 
 	enum Source : uint8_t {
@@ -32,46 +60,179 @@ namespace can {
 		Available = 0b10
 	};
 
-	#pragma pack(1)
 	struct Radio {
-		uint8_t _1 : 5;
-		bool muted : 1;
-		uint8_t _2 : 1;
-		bool enabled : 1;
+		static constexpr uint32_t ID = RADIO_ID;
+		static constexpr uint8_t LENGTH = 4;
+
+		static constexpr Field MUTED = {5, 1};
+		static constexpr Field ENABLED = {7, 1};
+		static constexpr Field CD_CHANGER_AVAILABLE = {12, 1};
+		static constexpr Field DISK_STATUS = {13, 2};
+		static constexpr Field SOURCE = {20, 3};
+		static constexpr Field FIELDS[] = {MUTED, ENABLED, CD_CHANGER_AVAILABLE, DISK_STATUS, SOURCE};
 
-		uint8_t _3 : 4;
-		bool cd_changer_available : 1;
-		DiskStatus disk_status : 2;
-		uint8_t _4 : 1;
+		bool muted;
+		bool enabled;
+		bool cd_changer_available;
+		DiskStatus disk_status;
+		Source source;
 
-		uint8_t _5 : 4;
-		Source source : 3;
-		uint8_t _6 : 1;
+		static constexpr Radio decode(const uint8_t* data) {
+			return {
+				.muted = (bool)get(data, MUTED),
+				.enabled = (bool)get(data, ENABLED),
+				.cd_changer_available = (bool)get(data, CD_CHANGER_AVAILABLE),
+				.disk_status = (DiskStatus)get(data, DISK_STATUS),
+				.source = (Source)get(data, SOURCE),
+			};
+		}
 
-		uint8_t _7 : 8;
+		// Only touches the bits of the fields, the rest of the payload is left as is
+		constexpr void encode(uint8_t* data) const {
+			set(data, MUTED, muted);
+			set(data, ENABLED, enabled);
+			set(data, CD_CHANGER_AVAILABLE, cd_changer_available);
+			set(data, DISK_STATUS, disk_status);
+			set(data, SOURCE, source);
+		}
 	};
-	#pragma pack()
 
-	#pragma pack(1)
 	struct Buttons {
-		uint8_t _1 : 1;
-		bool source : 1;
-		bool volume_down : 1;
-		bool volume_up : 1;
-		uint8_t _2 : 2;
-		bool backward : 1;
-		bool forward : 1;
+		static constexpr uint32_t ID = BUTTONS_ID;
+		static constexpr uint8_t LENGTH = 3;
 
-		uint8_t scroll : 8;
+		static constexpr Field SOURCE = {1, 1};
+		static constexpr Field VOLUME_DOWN = {2, 1};
+		static constexpr Field VOLUME_UP = {3, 1};
+		static constexpr Field BACKWARD = {6, 1};
+		static constexpr Field FORWARD = {7, 1};
+		static constexpr Field SCROLL = {8, 8};
+		static constexpr Field FIELDS[] = {SOURCE, VOLUME_DOWN, VOLUME_UP, BACKWARD, FORWARD, SCROLL};
 
-		uint8_t _3 : 8;
+		bool source;
+		bool volume_down;
+		bool volume_up;
+		bool backward;
+		bool forward;
+		uint8_t scroll;
+
+		static constexpr Buttons decode(const uint8_t* data) {
+			return {
+				.source = (bool)get(data, SOURCE),
+				.volume_down = (bool)get(data, VOLUME_DOWN),
+				.volume_up = (bool)get(data, VOLUME_UP),
+				.backward = (bool)get(data, BACKWARD),
+				.forward = (bool)get(data, FORWARD),
+				.scroll = (uint8_t)get(data, SCROLL),
+			};
+		}
+
+		constexpr void encode(uint8_t* data) const {
+			set(data, SOURCE, source);
+			set(data, VOLUME_DOWN, volume_down);
+			set(data, VOLUME_UP, volume_up);
+			set(data, BACKWARD, backward);
+			set(data, FORWARD, forward);
+			set(data, SCROLL, scroll);
+		}
 	};
-	#pragma pack()
 
-	#pragma pack(1)
 	struct Volume {
-		uint8_t volume : 5;
-		uint8_t _1 : 3;
+		static constexpr uint32_t ID = VOLUME_ID;
+		static constexpr uint8_t LENGTH = 1;
+
+		static constexpr Field VOLUME = {0, 5};
+		static constexpr Field FIELDS[] = {VOLUME};
+
+		uint8_t volume;
+
+		static constexpr Volume decode(const uint8_t* data) {
+			return {
+				.volume = (uint8_t)get(data, VOLUME),
+			};
+		}
+
+		constexpr void encode(uint8_t* data) const {
+			set(data, VOLUME, volume);
+		}
+	};
+
+	// Every field has to fit in the payload and no two fields can share a bit
+	template <typename M>
+	constexpr bool valid() {
+		uint64_t used = 0;
+		for (Field field : M::FIELDS) {
+			if (field.width == 0 || field.width > 24 || field.offset + field.width > M::LENGTH * 8) {
+				return false;
+			}
+
+			uint64_t bits = (uint64_t)mask(field) << field.offset;
+			if (used & bits) {
+				return false;
+			}
+			used |= bits;
+		}
+		return true;
+	}
+
+	// Every value of every field has to come back out of decode in the right member and go back into the same bits
+	template <typename M>
+	constexpr bool round_trips() {
+		for (Field field : M::FIELDS) {
+			for (uint32_t value = 0; value <= mask(field); value++) {
+				uint8_t in[8] = {};
+				set(in, field, value);
+
+				uint8_t out[8] = {};
+				M::decode(in).encode(out);
+
+				for (size_t i = 0; i < M::LENGTH; i++) {
+					if (in[i] != out[i]) {
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	static_assert(valid<Radio>() && round_trips<Radio>());
+	static_assert(valid<Buttons>() && round_trips<Buttons>());
+	static_assert(valid<Volume>() && round_trips<Volume>());
+
+	struct Handler {
+		uint32_t id;
+		uint8_t length;
+		void (*handle)(const uint8_t* data);
 	};
-	#pragma pack()
+
+	template <typename M, void (*F)(const M&)>
+	constexpr Handler handler() {
+		return {M::ID, M::LENGTH, [](const uint8_t* data) { F(M::decode(data)); }};
+	}
+
+	enum class Dispatch : uint8_t {
+		HANDLED,
+		// Nobody listens to the ID
+		IGNORED,
+		// A frame that does not match the description would decode into garbage, so it is dropped
+		MALFORMED,
+	};
+
+	template <size_t N>
+	constexpr Dispatch dispatch(const Handler (&handlers)[N], uint32_t id, bool rtr, uint8_t length, const uint8_t* data) {
+		for (const Handler& h : handlers) {
+			if (h.id != id) {
+				continue;
+			}
+
+			if (rtr || length != h.length) {
+				return Dispatch::MALFORMED;
+			}
+
+			h.handle(data);
+			return Dispatch::HANDLED;
+		}
+		return Dispatch::IGNORED;
+	}
 }
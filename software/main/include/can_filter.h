@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// Builds the acceptance filter of the TWAI controller from the IDs we listen to
+// The controller compares the frame against a code and a mask, in dual filter mode against two of them,
+// every ID that matches but is not ours is a false positive that the software filter has to drop
+namespace can {
+	constexpr uint16_t STANDARD_ID_MASK = 0x7FF;
+
+	// A set bit in the mask means the bit is not compared
+	struct Pattern {
+		uint16_t code;
+		uint16_t mask;
+
+		constexpr bool matches(uint16_t id) const {
+			return ((id ^ code) & ~mask & STANDARD_ID_MASK) == 0;
+		}
+
+		constexpr uint32_t size() const {
+			return 1u << std::popcount((uint16_t)(mask & STANDARD_ID_MASK));
+		}
+	};
+
+	// Amount of IDs that match both patterns
+	constexpr uint32_t overlap(Pattern a, Pattern b) {
+		if ((a.code ^ b.code) & ~a.mask & ~b.mask & STANDARD_ID_MASK) {
+			return 0;
+		}
+		return 1u << std::popcount((uint16_t)(a.mask & b.mask & STANDARD_ID_MASK));
+	}
+
+	struct Filter {
+		bool single;
+		Pattern first;
+		Pattern second;
+
+		constexpr bool accepts(uint16_t id) const {
+			return first.matches(id) || (!single && second.matches(id));
+		}
+
+		constexpr uint32_t accepted() const {
+			return single ? first.size() : first.size() + second.size() - overlap(first, second);
+		}
+
+		// Layout of the registers for standard frames, the RTR bit and the data bytes are never compared
+		// Single: ID in 31-21, RTR in 20, 19-16 unused, the first two data bytes in 15-0
+		// Dual: first ID in 31-21, RTR in 20, half of the first data byte in 19-16 and 3-0, second ID in 15-5, RTR in 4
+		constexpr uint32_t acceptance_code() const {
+			if (single) {
+				return (uint32_t)first.code << 21;
+			}
+			return ((uint32_t)first.code << 21) | ((uint32_t)second.code << 5);
+		}
+
+		constexpr uint32_t acceptance_mask() const {
+			if (single) {
+				return ((uint32_t)first.mask << 21) | 0x1FFFFF;
+			}
+			return ((uint32_t)first.mask << 21) | 0x1F0000 | ((uint32_t)second.mask << 5) | 0x1F;
+		}
+	};
+
+	// Tightest single pattern for the IDs selected by the bits of subset
+	template <size_t N>
+	constexpr Pattern cover(const std::array<uint16_t, N>& ids, uint32_t subset) {
+		Pattern pattern = {0, 0};
+		bool first = true;
+		for (size_t i = 0; i < N; i++) {
+			if (!(subset & (1u << i))) {
+				continue;
+			}
+
+			if (first) {
+				pattern.code = ids[i];
+				first = false;
+			}
+			pattern.mask |= ids[i] ^ pattern.code;
+		}
+		pattern.code &= ~pattern.mask;
+		return pattern;
+	}
+
+	// Tries every way of splitting the IDs over the two filters and keeps the one that lets through the fewest IDs
+	// A single filter wins a tie, so every frame only has to be compared once
+	template <size_t N>
+	constexpr Filter make_filter(const std::array<uint16_t, N>& ids) {
+		static_assert(N > 0 && N < 16, "The filters are searched exhaustively");
+
+		uint32_t all = (1u << N) - 1;
+		Filter best = {true, cover(ids, all), {0, 0}};
+
+		// The first ID always goes in the first filter, the other half of the search is the same split mirrored
+		for (uint32_t subset = 1; subset < all; subset += 2) {
+			Filter filter = {false, cover(ids, subset), cover(ids, all & ~subset)};
+			if (filter.accepted() < best.accepted()) {
+				best = filter;
+			}
+		}
+		return best;
+	}
+
+	template <size_t N>
+	constexpr bool contains(const std::array<uint16_t, N>& ids, uint16_t id) {
+		for (uint16_t i : ids) {
+			if (i == id) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template <size_t N>
+	constexpr size_t count_false_positives(const Filter& filter, const std::array<uint16_t, N>& ids) {
+		size_t count = 0;
+		for (uint16_t id = 0; id <= STANDARD_ID_MASK; id++) {
+			count += filter.accepts(id) && !contains(ids, id);
+		}
+		return count;
+	}
+
+	template <size_t K, size_t N>
+	constexpr std::array<uint16_t, K> false_positives(const Filter& filter, const std::array<uint16_t, N>& ids) {
+		std::array<uint16_t, K> result = {};
+		size_t count = 0;
+		for (uint16_t id = 0; id <= STANDARD_ID_MASK; id++) {
+			if (filter.accepts(id) && !contains(ids, id)) {
+				result[count++] = id;
+			}
+		}
+		return result;
+	}
+
+	// Sweeps every standard ID, every subscribed ID has to get through and nothing else except the false positives
+	template <size_t N>
+	constexpr bool verify(const Filter& filter, const std::array<uint16_t, N>& ids) {
+		size_t accepted = 0;
+		for (uint16_t id = 0; id <= STANDARD_ID_MASK; id++) {
+			if (contains(ids, id) && !filter.accepts(id)) {
+				return false;
+			}
+			accepted += filter.accepts(id);
+		}
+		return accepted == filter.accepted() && accepted == N + count_false_positives(filter, ids);
+	}
+
+	// Software filter, a bit for every standard ID
+	class IdSet {
+		public:
+			template <size_t N>
+			constexpr IdSet(const std::array<uint16_t, N>& ids) {
+				for (uint16_t id : ids) {
+					bits[id / 32] |= 1u << (id % 32);
+				}
+			}
+
+			constexpr bool contains(uint32_t id) const {
+				return id <= STANDARD_ID_MASK && (bits[id / 32] & (1u << (id % 32)));
+			}
+
+		private:
+			uint32_t bits[(STANDARD_ID_MASK + 1) / 32] = {};
+	};
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "cache.h"
+
+// Bounded lock-free queue that can be pushed to from multiple tasks
+// Every cell carries a sequence number that tells producers and the consumer whose turn it is
+template <typename T, size_t N>
+class CommandQueue {
+	static_assert(N && (N & (N - 1)) == 0, "The size has to be a power of two");
+
+	public:
+		CommandQueue() {
+			for (size_t i = 0; i < N; i++) {
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		// Returns false if the queue is full
+		bool push(const T& value) {
+			size_t position = head.load(std::memory_order_relaxed);
+			for (;;) {
+				Cell& cell = cells[position & (N - 1)];
+				intptr_t difference = (intptr_t)cell.sequence.load(std::memory_order_acquire) - (intptr_t)position;
+
+				if (difference == 0) {
+					if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						cell.value = value;
+						cell.sequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (difference < 0) {
+					return false;
+				} else {
+					position = head.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// Returns false if the queue is empty
+		bool pop(T& value) {
+			size_t position = tail.load(std::memory_order_relaxed);
+			for (;;) {
+				Cell& cell = cells[position & (N - 1)];
+				intptr_t difference = (intptr_t)cell.sequence.load(std::memory_order_acquire) - (intptr_t)(position + 1);
+
+				if (difference == 0) {
+					if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						value = cell.value;
+						cell.sequence.store(position + N, std::memory_order_release);
+						return true;
+					}
+				} else if (difference < 0) {
+					return false;
+				} else {
+					position = tail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+	private:
+		struct Cell {
+			std::atomic<size_t> sequence;
+			T value;
+		};
+
+		Cell cells[N];
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> head{0};
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail{0};
+};
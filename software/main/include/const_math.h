@@ -0,0 +1,71 @@
+#pragma once
+
+// Math functions that can be evaluated at compile time, so filter coefficients and tables end up in flash
+// They are accurate to about double precision within the ranges audio filters use, and also work at runtime
+namespace const_math {
+	constexpr double PI = 3.14159265358979323846;
+	constexpr double LN10 = 2.30258509299404568402;
+
+	constexpr double abs(double x) {
+		return x < 0 ? -x : x;
+	}
+
+	// Taylor series after reducing the argument to [-pi, pi]
+	constexpr double sin(double x) {
+		while (x > PI) {
+			x -= 2 * PI;
+		}
+		while (x < -PI) {
+			x += 2 * PI;
+		}
+
+		double term = x;
+		double sum = x;
+		for (int n = 1; n < 20; n++) {
+			term *= -x * x / ((2 * n) * (2 * n + 1));
+			sum += term;
+		}
+		return sum;
+	}
+
+	constexpr double cos(double x) {
+		return sin(x + PI / 2);
+	}
+
+	// Taylor series of a fraction of the argument, squared back up
+	constexpr double exp(double x) {
+		int halvings = 0;
+		while (abs(x) > 0.5) {
+			x /= 2;
+			halvings++;
+		}
+
+		double term = 1;
+		double sum = 1;
+		for (int n = 1; n < 16; n++) {
+			term *= x / n;
+			sum += term;
+		}
+
+		for (int i = 0; i < halvings; i++) {
+			sum *= sum;
+		}
+		return sum;
+	}
+
+	constexpr double sqrt(double x) {
+		if (x <= 0) {
+			return 0;
+		}
+
+		double y = x > 1 ? x : 1;
+		for (int i = 0; i < 64; i++) {
+			y = (y + x / y) / 2;
+		}
+		return y;
+	}
+
+	constexpr double db_to_gain(double db) {
+		return exp(db / 20 * LN10);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+// Gains in ratio per frame of error, the loop settles within a few minutes without audible pitch modulation
+// test/drift.cpp simulates the loop with these
+#define DRIFT_KP 5e-7f
+#define DRIFT_KI 2e-10f
+// Limits the correction to 2000 ppm
+#define DRIFT_LIMIT 0.002f
+
+// PI controller that keeps the buffer between bluetooth and i2s at a fixed depth
+// The output is the ratio between the rate at which we consume and the nominal rate
+class DriftController {
+	public:
+		// The gains are in ratio per frame of error, limit is the maximum deviation from 1
+		DriftController(float kp, float ki, float limit);
+
+		void set_target(size_t frames);
+		size_t get_target() const { return target; }
+
+		// Should be called once per output block with the current fill level of the buffer
+		float update(size_t fill);
+		void reset();
+
+		float get_ratio() const { return ratio; }
+		float get_fill() const { return filtered; }
+
+	private:
+		const float kp;
+		const float ki;
+		const float limit;
+
+		size_t target = 0;
+		float filtered = 0;
+		float integral = 0;
+		float ratio = 1;
+		bool primed = false;
+};
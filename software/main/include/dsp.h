@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+// Length of the fade when muting, about 3ms at 44.1 kHz
+#define DSP_MUTE_FADE_FRAMES 128
+
+// Compile time composed processing chain for the stereo stream
+// Every stage is a template parameter, the chain inlines all of them into a single pass over the block,
+// so every sample is read and written exactly once and a disabled stage does not generate any code
+//
+// A stage has a `Frame process(Frame)` that is called for every frame
+// It can optionally have a `void begin(size_t length)` and `void end()` that are called once per block
+namespace dsp {
+#ifdef CONFIG_CAR_STEREO_DSP_FIXED_POINT
+	// Samples are 16 bit audio with 8 extra fractional bits, which leaves 7 bits of headroom
+	using Sample = int32_t;
+	// Coefficients are Q28, so they range from -8 to 8
+	using Coefficient = int32_t;
+
+	constexpr int SAMPLE_SHIFT = 8;
+	constexpr int COEFFICIENT_SHIFT = 28;
+
+	constexpr Coefficient coefficient(float value) {
+		return (Coefficient)(value * (1 << COEFFICIENT_SHIFT) + (value < 0 ? -0.5f : 0.5f));
+	}
+
+	inline Sample mul(Sample sample, Coefficient coefficient) {
+		return (Sample)(((int64_t)sample * coefficient) >> COEFFICIENT_SHIFT);
+	}
+
+	inline Sample from_int16(int16_t sample) {
+		return (Sample)sample << SAMPLE_SHIFT;
+	}
+
+	inline int16_t to_int16(Sample sample) {
+		return (int16_t)std::clamp<Sample>((sample + (1 << (SAMPLE_SHIFT - 1))) >> SAMPLE_SHIFT, -32768, 32767);
+	}
+#else
+	// The ESP32 has a single precision FPU, samples keep the scale of 16 bit audio
+	using Sample = float;
+	using Coefficient = float;
+
+	constexpr Coefficient coefficient(float value) {
+		return value;
+	}
+
+	inline Sample mul(Sample sample, Coefficient coefficient) {
+		return sample * coefficient;
+	}
+
+	inline Sample from_int16(int16_t sample) {
+		return sample;
+	}
+
+	inline int16_t to_int16(Sample sample) {
+		return (int16_t)lrintf(std::clamp(sample, -32768.f, 32767.f));
+	}
+#endif
+
+	struct Frame {
+		Sample left;
+		Sample right;
+	};
+
+	inline Frame unpack(uint32_t frame) {
+		return {from_int16((int16_t)frame), from_int16((int16_t)(frame >> 16))};
+	}
+
+	inline uint32_t pack(Frame frame) {
+		return (uint16_t)to_int16(frame.left) | ((uint32_t)(uint16_t)to_int16(frame.right) << 16);
+	}
+
+	// Stands in for a stage that is disabled at compile time
+	struct Bypass {
+		Frame process(Frame frame) { return frame; }
+	};
+
+	template <bool Enabled, typename Stage>
+	using Optional = std::conditional_t<Enabled, Stage, Bypass>;
+
+	template <typename... Stages>
+	class Chain {
+		public:
+			// Stages are looked up by type, so a chain can only contain a stage once
+			template <typename Stage>
+			Stage& get() { return std::get<Stage>(stages); }
+
+			void process(uint32_t* frames, size_t length) {
+				process(frames, length, std::index_sequence_for<Stages...>{});
+			}
+
+		private:
+			template <size_t... I>
+			void process(uint32_t* frames, size_t length, std::index_sequence<I...>) {
+				(begin(std::get<I>(stages), length), ...);
+
+				for (size_t i = 0; i < length; i++) {
+					Frame frame = unpack(frames[i]);
+					((frame = std::get<I>(stages).process(frame)), ...);
+					frames[i] = pack(frame);
+				}
+
+				(end(std::get<I>(stages)), ...);
+			}
+
+			template <typename Stage>
+			static void begin(Stage& stage, size_t length) {
+				if constexpr (requires { stage.begin(length); }) {
+					stage.begin(length);
+				}
+			}
+
+			template <typename Stage>
+			static void end(Stage& stage) {
+				if constexpr (requires { stage.end(); }) {
+					stage.end();
+				}
+			}
+
+			std::tuple<Stages...> stages;
+	};
+
+	// Ramps linearly to a new gain over one block, so changes do not click
+	class Gain {
+		public:
+			void set(float gain) { target = coefficient(gain); }
+
+			void begin(size_t length) {
+				step = length ? (target - gain) / (Coefficient)length : 0;
+			}
+
+			Frame process(Frame frame) {
+				gain += step;
+				return {mul(frame.left, gain), mul(frame.right, gain)};
+			}
+
+			// Rounding errors in the ramp should not accumulate
+			void end() {
+				gain = target;
+			}
+
+		private:
+			Coefficient target = coefficient(1.f);
+			Coefficient gain = coefficient(1.f);
+			Coefficient step = 0;
+	};
+
+	// Fades to silence and back per frame, so muting takes effect within a few milliseconds instead of a block
+	class Mute {
+		public:
+			void set(bool muted) { target = muted ? 0 : ONE; }
+			// Completely faded out
+			bool silent() const { return !gain && !target; }
+
+			Frame process(Frame frame) {
+				if (gain == target) {
+					return gain ? frame : Frame{0, 0};
+				}
+
+				gain = target ? std::min(gain + STEP, ONE) : std::max(gain - STEP, (Coefficient)0);
+				return {mul(frame.left, gain), mul(frame.right, gain)};
+			}
+
+		private:
+			static constexpr Coefficient ONE = coefficient(1.f);
+			static constexpr Coefficient STEP = ONE / DSP_MUTE_FADE_FRAMES;
+
+			Coefficient target = ONE;
+			Coefficient gain = ONE;
+	};
+
+	struct Swap {
+		Frame process(Frame frame) { return {frame.right, frame.left}; }
+	};
+
+	struct Invert {
+		Frame process(Frame frame) { return {-frame.left, -frame.right}; }
+	};
+}
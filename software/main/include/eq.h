@@ -0,0 +1,273 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "dsp.h"
+#include "const_math.h"
+
+// Bands per preset, every band costs the same whether it does anything or not
+#define EQ_BANDS 5
+// Length of the crossfade when the coefficients change, a bit over 5ms at 44.1 kHz
+#define EQ_CROSSFADE_FRAMES 256
+
+// Parametric equalizer made out of a cascade of biquads, designed with the formulas from the Audio EQ Cookbook
+namespace eq {
+	enum class Type : uint8_t {
+		NONE,
+		PEAKING,
+		LOW_SHELF,
+		HIGH_SHELF,
+		HIGH_PASS,
+		LOW_PASS,
+	};
+
+	struct Band {
+		Type type;
+		float frequency;
+		float gain_db;
+		float q;
+	};
+
+	enum class Preset : uint8_t {
+		FLAT,
+		// A starting point for speakers in the doors, measure the car before trusting it
+		CABIN,
+		BASS,
+		VOICE,
+
+		COUNT,
+	};
+
+	struct PresetDefinition {
+		const char* name;
+		// Headroom for the boosts, folded into the first band
+		float preamp_db;
+		Band bands[EQ_BANDS];
+	};
+
+	// Normalized so a0 is one
+	struct Coefficients {
+		dsp::Coefficient b0;
+		dsp::Coefficient b1;
+		dsp::Coefficient b2;
+		dsp::Coefficient a1;
+		dsp::Coefficient a2;
+	};
+
+	template <size_t N>
+	using Bank = std::array<Coefficients, N>;
+
+	constexpr PresetDefinition presets[(size_t)Preset::COUNT] = {
+		{"Flat", 0, {}},
+		{"Cabin", -3, {
+			// Keep small door speakers from bottoming out
+			{Type::HIGH_PASS, 35, 0, 0.707f},
+			// Cabins usually boom in the low mids
+			{Type::PEAKING, 125, -4, 1.4f},
+			{Type::PEAKING, 400, -2, 1.f},
+			{Type::PEAKING, 2500, -2, 1.5f},
+			{Type::HIGH_SHELF, 8000, 3, 0.707f},
+		}},
+		{"Bass", -6, {
+			{Type::HIGH_PASS, 35, 0, 0.707f},
+			{Type::LOW_SHELF, 100, 6, 0.707f},
+		}},
+		{"Voice", -3, {
+			{Type::HIGH_PASS, 100, 0, 0.707f},
+			{Type::PEAKING, 3000, 3, 1.f},
+		}},
+	};
+
+	constexpr Coefficients design(const Band& band, uint32_t sample_rate, double gain = 1) {
+		if (band.type == Type::NONE) {
+			return {dsp::coefficient(gain), 0, 0, 0, 0};
+		}
+
+		// A band at or above the Nyquist frequency would be degenerate
+		double frequency = band.frequency < 0.45 * sample_rate ? band.frequency : 0.45 * sample_rate;
+		double w0 = 2 * const_math::PI * frequency / sample_rate;
+		double cos_w0 = const_math::cos(w0);
+		double alpha = const_math::sin(w0) / (2 * band.q);
+		double A = const_math::sqrt(const_math::db_to_gain(band.gain_db));
+
+		double b0 = 1, b1 = 0, b2 = 0, a0 = 1, a1 = 0, a2 = 0;
+		switch (band.type) {
+			case Type::PEAKING:
+				b0 = 1 + alpha * A;
+				b1 = -2 * cos_w0;
+				b2 = 1 - alpha * A;
+				a0 = 1 + alpha / A;
+				a1 = -2 * cos_w0;
+				a2 = 1 - alpha / A;
+				break;
+
+			case Type::LOW_SHELF: {
+				double root = 2 * const_math::sqrt(A) * alpha;
+				b0 = A * ((A + 1) - (A - 1) * cos_w0 + root);
+				b1 = 2 * A * ((A - 1) - (A + 1) * cos_w0);
+				b2 = A * ((A + 1) - (A - 1) * cos_w0 - root);
+				a0 = (A + 1) + (A - 1) * cos_w0 + root;
+				a1 = -2 * ((A - 1) + (A + 1) * cos_w0);
+				a2 = (A + 1) + (A - 1) * cos_w0 - root;
+				break;
+			}
+
+			case Type::HIGH_SHELF: {
+				double root = 2 * const_math::sqrt(A) * alpha;
+				b0 = A * ((A + 1) + (A - 1) * cos_w0 + root);
+				b1 = -2 * A * ((A - 1) + (A + 1) * cos_w0);
+				b2 = A * ((A + 1) + (A - 1) * cos_w0 - root);
+				a0 = (A + 1) - (A - 1) * cos_w0 + root;
+				a1 = 2 * ((A - 1) - (A + 1) * cos_w0);
+				a2 = (A + 1) - (A - 1) * cos_w0 - root;
+				break;
+			}
+
+			case Type::HIGH_PASS:
+				b0 = (1 + cos_w0) / 2;
+				b1 = -(1 + cos_w0);
+				b2 = (1 + cos_w0) / 2;
+				a0 = 1 + alpha;
+				a1 = -2 * cos_w0;
+				a2 = 1 - alpha;
+				break;
+
+			case Type::LOW_PASS:
+				b0 = (1 - cos_w0) / 2;
+				b1 = 1 - cos_w0;
+				b2 = (1 - cos_w0) / 2;
+				a0 = 1 + alpha;
+				a1 = -2 * cos_w0;
+				a2 = 1 - alpha;
+				break;
+
+			default:
+				break;
+		}
+
+		return {
+			dsp::coefficient(gain * b0 / a0),
+			dsp::coefficient(gain * b1 / a0),
+			dsp::coefficient(gain * b2 / a0),
+			dsp::coefficient(a1 / a0),
+			dsp::coefficient(a2 / a0),
+		};
+	}
+
+	constexpr Bank<EQ_BANDS> design(Preset preset, uint32_t sample_rate) {
+		const PresetDefinition& definition = presets[(size_t)preset];
+
+		Bank<EQ_BANDS> bank = {};
+		for (size_t i = 0; i < EQ_BANDS; i++) {
+			bank[i] = design(definition.bands[i], sample_rate, i == 0 ? const_math::db_to_gain(definition.preamp_db) : 1);
+		}
+		return bank;
+	}
+
+	// Precomputed for the sample rates A2DP can use, anything else is designed on the fly
+	Bank<EQ_BANDS> get_bank(Preset preset, uint32_t sample_rate);
+	const char* get_name(Preset preset);
+
+	template <size_t N>
+	class Cascade {
+		public:
+			void load(const Bank<N>& b) {
+				bank = b;
+				state = {};
+			}
+
+			dsp::Frame process(dsp::Frame frame) {
+				for (size_t i = 0; i < N; i++) {
+					frame.left = biquad(bank[i], state[i].left, frame.left);
+					frame.right = biquad(bank[i], state[i].right, frame.right);
+				}
+				return frame;
+			}
+
+		private:
+#ifdef CONFIG_CAR_STEREO_DSP_FIXED_POINT
+			// Direct form I keeps the fixed point state in the range of the signal, the products are summed before rounding
+			struct State {
+				dsp::Sample x1, x2, y1, y2;
+			};
+
+			static dsp::Sample biquad(const Coefficients& c, State& s, dsp::Sample x) {
+				int64_t sum = (int64_t)c.b0 * x + (int64_t)c.b1 * s.x1 + (int64_t)c.b2 * s.x2 - (int64_t)c.a1 * s.y1 - (int64_t)c.a2 * s.y2;
+				dsp::Sample y = (dsp::Sample)(sum >> dsp::COEFFICIENT_SHIFT);
+
+				s.x2 = s.x1;
+				s.x1 = x;
+				s.y2 = s.y1;
+				s.y1 = y;
+				return y;
+			}
+#else
+			// Transposed direct form II needs the least state and operations in floating point
+			struct State {
+				dsp::Sample z1, z2;
+			};
+
+			static dsp::Sample biquad(const Coefficients& c, State& s, dsp::Sample x) {
+				dsp::Sample y = c.b0 * x + s.z1;
+				s.z1 = c.b1 * x - c.a1 * y + s.z2;
+				s.z2 = c.b2 * x - c.a2 * y;
+				return y;
+			}
+#endif
+
+			struct ChannelState {
+				State left;
+				State right;
+			};
+
+			Bank<N> bank = {};
+			std::array<ChannelState, N> state = {};
+	};
+
+	// Chain stage, new coefficients are crossfaded in so changing the rate or preset does not click
+	template <size_t N>
+	class Equalizer {
+		public:
+			Equalizer() {
+				Bank<N> bank = {};
+				bank.fill({dsp::coefficient(1.f), 0, 0, 0, 0});
+				cascades[0].load(bank);
+			}
+
+			// A change while the previous one is still fading in has to wait
+			bool busy() const { return fade; }
+
+			void set(const Bank<N>& bank) {
+				active ^= 1;
+				cascades[active].load(bank);
+				fade = EQ_CROSSFADE_FRAMES;
+			}
+
+			dsp::Frame process(dsp::Frame frame) {
+				dsp::Frame output = cascades[active].process(frame);
+				if (!fade) {
+					return output;
+				}
+
+				// Linear crossfade from the old to the new coefficients
+				dsp::Frame old = cascades[active ^ 1].process(frame);
+				fade--;
+				return {
+					old.left + dsp::mul(output.left - old.left, weight()),
+					old.right + dsp::mul(output.right - old.right, weight()),
+				};
+			}
+
+		private:
+			dsp::Coefficient weight() const {
+				return (dsp::Coefficient)(dsp::coefficient(1.f) / EQ_CROSSFADE_FRAMES) * (EQ_CROSSFADE_FRAMES - fade);
+			}
+
+			Cascade<N> cascades[2];
+			uint8_t active = 0;
+			uint16_t fade = 0;
+	};
+}
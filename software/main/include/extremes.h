@@ -0,0 +1,18 @@
+#pragma once
+
+#include <atomic>
+
+// Running maximum and minimum that one task updates and another takes with an exchange, so neither side needs a lock
+namespace extremes {
+	template <typename T>
+	inline void raise(std::atomic<T>& extreme, T value) {
+		T current = extreme.load(std::memory_order_relaxed);
+		while (value > current && !extreme.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+	}
+
+	template <typename T>
+	inline void lower(std::atomic<T>& extreme, T value) {
+		T current = extreme.load(std::memory_order_relaxed);
+		while (value < current && !extreme.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+	}
+}
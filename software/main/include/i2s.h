@@ -1,14 +1,74 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
+
+#include "ring_buffer.h"
+#include "kernels.h"
+#include "jitter.h"
 
 #define I2S_PORT I2S_NUM_0
 
 namespace i2s {
+	struct Stats {
+		RingBuffer::Stats buffer;
+		size_t fill;
+		size_t capacity;
+		// Depth the buffer is kept at, follows the jitter of the bluetooth packets
+		size_t target;
+		size_t jitter;
+		Latency latency;
+		int32_t drift_ppm;
+		// Trim of the APLL, zero when the resampler absorbs the drift
+		int32_t apll_ppm;
+		uint32_t latency_us;
+		// DMA buffers that went out without new audio while streaming
+		uint32_t dma_underruns;
+		// Bytes of stack the processing and output tasks never touched
+		uint32_t task_stack_free;
+		uint32_t output_stack_free;
+	};
+
+	// Worst case cycles per block of every stage, the output stage includes the time spent waiting on i2s
+	struct Timing {
+		uint32_t resample;
+		uint32_t mix;
+		uint32_t dsp;
+		uint32_t kernels;
+		uint32_t total;
+		uint32_t output;
+		uint32_t frames;
+		// Cycles a block lasts at the output rate
+		uint32_t budget;
+	};
+
+	// Frames that have left i2s since boot, including silence, at the time it was taken
+	struct Position {
+		uint64_t frames;
+		int64_t time_us;
+	};
+
 	void init();
 
 	uint32_t get_sample_rate();
 	void set_sample_rate(uint32_t sample_rate);
+	uint32_t get_output_rate();
+	// Sample accurate, tracked with the DMA completion events
+	Position get_position();
+	// Frames the pipeline and DMA buffers hold ahead of the block that is being processed
+	uint32_t get_queued_frames();
+	// Time from a frame arriving over bluetooth until it leaves i2s
+	uint32_t get_latency_us();
+
+	// Trades dropouts for latency, overrides the mode from the configuration
+	void set_latency(Latency latency);
+	Latency get_latency();
+
+	// Overrides the channel mode and polarity from the configuration
+	void set_channels(kernels::Channels channels, bool inverted);
 
 	void write(const uint8_t* data, size_t length);
+
+	Stats get_stats();
+	Timing get_timing();
 }
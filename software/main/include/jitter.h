@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Length of a measurement window
+#define JITTER_WINDOW_US 1000000
+// Most windows any of the modes looks back over
+#define JITTER_HISTORY 32
+// A gap this long means the stream was paused, it says nothing about the link
+#define JITTER_GAP_US 500000
+
+enum class Latency : uint8_t {
+	// For video and games, a dropout now and then is better than lagging behind the picture
+	LOW,
+	NORMAL,
+	// Keeps enough in the buffer to ride out the long gaps when the link is bad
+	ROBUST,
+
+	COUNT,
+};
+
+// Measures how bursty bluetooth delivers the audio and derives how deep the buffer has to be to play through it
+// Every packet is compared to a clock that runs at the sample rate, the spread in how early or late packets arrive
+// is how much the buffer has to hold to never run dry
+class JitterEstimator {
+	public:
+		// The margin of every mode covers at least a block of this many frames
+		constexpr JitterEstimator(size_t block_frames) : block_frames(block_frames) {}
+
+		// Called for every packet as it arrives
+		void arrive(int64_t time_us, size_t frames, uint32_t sample_rate);
+
+		// Worst spread in frames over the history of the mode
+		size_t get_jitter(Latency latency) const;
+		// Buffer depth for the mode, includes a margin for the block size of i2s
+		size_t get_target(Latency latency) const;
+
+		static const char* get_name(Latency latency);
+
+	private:
+		size_t block_frames;
+
+		// The clock starts over after a gap or a change of the sample rate
+		uint32_t rate = 0;
+		int64_t last_arrival = 0;
+		int64_t origin = 0;
+		// Frames received since the origin
+		int64_t received = 0;
+
+		int64_t window_start = 0;
+		// Earliest and latest arrival in the window, in frames relative to the clock
+		int64_t earliest = 0;
+		int64_t latest = 0;
+
+		uint32_t spreads[JITTER_HISTORY] = {};
+		size_t current = 0;
+};
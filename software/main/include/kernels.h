@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// In place kernels for the stereo stream, every frame is a single word with the first channel in the low half
+// They work on whole words and are unrolled by four, the naive versions that split every frame into a struct are in the benchmark
+namespace kernels {
+	enum class Channels : uint8_t {
+		STEREO,
+		SWAPPED,
+		MONO,
+	};
+
+	// Applies f to every frame, four at a time
+	template <typename F>
+	inline void each(uint32_t* frames, size_t length, F f) {
+		size_t i = 0;
+		for (; i + 4 <= length; i += 4) {
+			frames[i] = f(frames[i]);
+			frames[i + 1] = f(frames[i + 1]);
+			frames[i + 2] = f(frames[i + 2]);
+			frames[i + 3] = f(frames[i + 3]);
+		}
+		for (; i < length; i++) {
+			frames[i] = f(frames[i]);
+		}
+	}
+
+	// A rotate by half a word swaps the channels
+	inline uint32_t swap(uint32_t frame) {
+		return (frame >> 16) | (frame << 16);
+	}
+
+	inline uint32_t downmix(uint32_t frame) {
+		int32_t mono = ((int32_t)(int16_t)frame + (int16_t)(frame >> 16)) >> 1;
+		return (uint16_t)mono * 0x00010001u;
+	}
+
+	// The ones' complement is -x - 1, which can not overflow and is off by a single LSB of DC
+	inline uint32_t invert(uint32_t frame) {
+		return ~frame;
+	}
+
+	inline void swap(uint32_t* frames, size_t length) {
+		each(frames, length, [](uint32_t frame) { return swap(frame); });
+	}
+
+	inline void downmix(uint32_t* frames, size_t length) {
+		each(frames, length, [](uint32_t frame) { return downmix(frame); });
+	}
+
+	inline void invert(uint32_t* frames, size_t length) {
+		each(frames, length, [](uint32_t frame) { return invert(frame); });
+	}
+
+	// Dispatches once per block, so the inner loops do not have to branch
+	inline void apply(Channels channels, bool inverted, uint32_t* frames, size_t length) {
+		if (channels == Channels::SWAPPED && inverted) {
+			each(frames, length, [](uint32_t frame) { return invert(swap(frame)); });
+			return;
+		}
+
+		if (channels == Channels::SWAPPED) {
+			swap(frames, length);
+		} else if (channels == Channels::MONO) {
+			downmix(frames, length);
+		}
+
+		if (inverted) {
+			invert(frames, length);
+		}
+	}
+
+	// Expands every 16 bit sample into the top of a 32 bit word, for DACs that take 24 or 32 bit data
+	// The output holds two words per frame and can not overlap the input
+	inline void expand(const uint32_t* input, uint32_t* output, size_t length) {
+		size_t i = 0;
+		for (; i + 2 <= length; i += 2) {
+			uint32_t a = input[i];
+			uint32_t b = input[i + 1];
+			output[2 * i] = a << 16;
+			output[2 * i + 1] = a & 0xFFFF0000;
+			output[2 * i + 2] = b << 16;
+			output[2 * i + 3] = b & 0xFFFF0000;
+		}
+		for (; i < length; i++) {
+			output[2 * i] = input[i] << 16;
+			output[2 * i + 1] = input[i] & 0xFFFF0000;
+		}
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+
+#include "dsp.h"
+
+// Frames the output is delayed by, about 3ms at 44.1 kHz
+#define LIMITER_LOOKAHEAD_FRAMES 128
+// The envelope is detected per segment instead of per frame
+#define LIMITER_SEGMENT_FRAMES 16
+#define LIMITER_SEGMENTS (LIMITER_LOOKAHEAD_FRAMES / LIMITER_SEGMENT_FRAMES)
+// Time it takes to recover from full attenuation, about 100ms at 44.1 kHz
+#define LIMITER_RELEASE_FRAMES 4096
+
+static_assert(LIMITER_LOOKAHEAD_FRAMES % LIMITER_SEGMENT_FRAMES == 0, "The look ahead has to consist of whole segments");
+
+// Look ahead peak limiter with an optional soft knee compressor in front of it
+// The gain is planned per segment so it reaches the required level right when the loudest frame of every segment leaves the delay line,
+// which means the output never exceeds the ceiling without any distortion from clipping
+namespace limiter {
+	struct Settings {
+		float ceiling_db = -1;
+		// The compressor is disabled with a ratio of one
+		float threshold_db = -12;
+		float ratio = 1;
+		float knee_db = 6;
+	};
+
+	class Limiter {
+		public:
+			Limiter() {
+				std::fill(std::begin(gains), std::end(gains), ONE);
+			}
+
+			void configure(const Settings& settings) {
+				ceiling = settings.ceiling_db;
+				ceiling_sample = (dsp::Sample)(dsp::from_int16(32767) * powf(10.f, settings.ceiling_db / 20.f));
+				threshold = settings.threshold_db;
+				slope = 1.f / settings.ratio - 1.f;
+				knee = settings.knee_db;
+			}
+
+			// Lowest gain since the last call, to see how hard the limiter is working
+			// Only call it from the task that runs the chain
+			float take_min_gain() {
+				float min = lowest;
+				lowest = 1.f;
+				return min;
+			}
+
+			dsp::Frame process(dsp::Frame frame) {
+				peak = std::max({peak, std::abs(frame.left), std::abs(frame.right)});
+
+				dsp::Frame output = delay[position];
+				delay[position] = frame;
+				position = (position + 1) % LIMITER_LOOKAHEAD_FRAMES;
+
+				gain = std::min(gain + step, ONE);
+				output = {
+					std::clamp(dsp::mul(output.left, gain), -ceiling_sample, ceiling_sample),
+					std::clamp(dsp::mul(output.right, gain), -ceiling_sample, ceiling_sample),
+				};
+
+				if (++count == LIMITER_SEGMENT_FRAMES) {
+					count = 0;
+					plan();
+				}
+
+				return output;
+			}
+
+		private:
+			static constexpr dsp::Coefficient ONE = dsp::coefficient(1.f);
+			static constexpr dsp::Coefficient RELEASE = ONE / LIMITER_RELEASE_FRAMES;
+
+			// Gain the compressor and limiter want for a peak, only runs once per segment so it can use the FPU
+			float required(dsp::Sample sample) const {
+				float level = 20.f * log10f(std::max((float)sample / dsp::from_int16(32767), 1e-6f));
+
+				// Soft knee from the Giannoulis, Massberg and Reiss compressor design
+				float reduction = 0;
+				float over = level - threshold;
+				if (2 * over >= knee) {
+					reduction = slope * over;
+				} else if (2 * over > -knee) {
+					reduction = slope * (over + knee / 2) * (over + knee / 2) / (2 * knee);
+				}
+
+				reduction = std::min(reduction, ceiling - level);
+				return std::min(powf(10.f, reduction / 20.f), 1.f);
+			}
+
+			// Picks the steepest ramp that still gets every segment in the delay line to its gain in time
+			void plan() {
+				gains[segment] = dsp::coefficient(required(peak));
+				segment = (segment + 1) % LIMITER_SEGMENTS;
+				peak = 0;
+
+				dsp::Coefficient next = RELEASE;
+				for (size_t i = 0; i < LIMITER_SEGMENTS; i++) {
+					// The oldest segment starts leaving on the next frame
+					dsp::Coefficient target = gains[(segment + i) % LIMITER_SEGMENTS];
+					int32_t start = i * LIMITER_SEGMENT_FRAMES + 1;
+
+					// When going up the gain also has to hold for the last frame of the segment
+					int32_t frames = target < gain ? start : start + LIMITER_SEGMENT_FRAMES - 1;
+					next = std::min(next, (dsp::Coefficient)((target - gain) / frames));
+				}
+				step = next;
+
+				lowest = std::min(lowest, (float)gain / ONE);
+			}
+
+			float ceiling = -1;
+			float threshold = 0;
+			float slope = 0;
+			float knee = 0;
+			dsp::Sample ceiling_sample = dsp::from_int16(32767);
+
+			dsp::Frame delay[LIMITER_LOOKAHEAD_FRAMES] = {};
+			size_t position = 0;
+
+			dsp::Sample peak = 0;
+			size_t count = 0;
+
+			dsp::Coefficient gains[LIMITER_SEGMENTS];
+			size_t segment = 0;
+
+			dsp::Coefficient gain = ONE;
+			dsp::Coefficient step = 0;
+			float lowest = 1.f;
+	};
+}
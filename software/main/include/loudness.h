@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include "eq.h"
+#include "const_math.h"
+
+// Volume steps of the radio
+#define LOUDNESS_STEPS 31
+// Radio volume at which the music sounds balanced without any compensation
+#define LOUDNESS_REFERENCE_STEP 24
+#define LOUDNESS_BANDS 2
+
+// Our ears lose the low and high end at low listening levels, so the shelves follow the volume of the radio
+// The volume itself is analog, so instead of boosting the bass and treble the middle is cut, which can not clip
+namespace loudness {
+	// Boost per step below the reference
+	constexpr float BASS_DB_PER_STEP = 0.5f;
+	constexpr float TREBLE_DB_PER_STEP = 0.15f;
+
+	constexpr eq::Bank<LOUDNESS_BANDS> design(uint8_t step, uint32_t sample_rate) {
+		float below = step < LOUDNESS_REFERENCE_STEP ? LOUDNESS_REFERENCE_STEP - step : 0;
+		float bass = BASS_DB_PER_STEP * below;
+		float treble = TREBLE_DB_PER_STEP * below;
+
+		return {
+			eq::design(eq::Band{eq::Type::LOW_SHELF, 100, bass, 0.707f}, sample_rate, const_math::db_to_gain(-(bass > treble ? bass : treble))),
+			eq::design(eq::Band{eq::Type::HIGH_SHELF, 10000, treble, 0.707f}, sample_rate),
+		};
+	}
+
+	// Precomputed for every step at the sample rates A2DP can use, anything else is designed on the fly
+	eq::Bank<LOUDNESS_BANDS> get_bank(uint8_t step, uint32_t sample_rate);
+
+	// Chain stage, crossfades between the steps
+	class Loudness : public eq::Equalizer<LOUDNESS_BANDS> {};
+}
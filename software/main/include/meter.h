@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+#include "dsp.h"
+
+// Anything quieter than this many LSB counts as digital silence, so dither does not keep us awake
+#define METER_SILENCE_LEVEL 4
+
+// Level meter for the stream that goes out over i2s
+// The chain stage only accumulates the block, everything that needs a log or a square root happens once per block or when a snapshot is taken
+namespace meter {
+	struct Level {
+		// dBFS over the frames since the previous snapshot
+		float rms_db;
+		float peak_db;
+		// Mean as a fraction of full scale
+		float dc;
+		// Samples that hit the rail since boot
+		uint32_t clips;
+	};
+
+	struct Snapshot {
+		Level left;
+		Level right;
+		uint32_t frames;
+		// Time since the last frame above the silence level, or since boot when nothing was played yet
+		uint32_t silent_ms;
+		bool silent;
+	};
+
+	// Sums over a single block of the 16 bit samples that go out
+	// Integers in both modes, a float sum of squares loses the quiet parts of a long block
+	struct Accumulator {
+		// A block of 32768 frames at full scale still fits
+		int32_t sum;
+		uint64_t squares;
+		int32_t peak;
+		uint32_t clips;
+	};
+
+	// Chain stage, has to come last so it sees exactly what is written to i2s
+	class Meter {
+		public:
+			void begin(size_t) {
+				left = {};
+				right = {};
+			}
+
+			dsp::Frame process(dsp::Frame frame) {
+				accumulate(left, frame.left);
+				accumulate(right, frame.right);
+				return frame;
+			}
+
+			const Accumulator& get_left() const { return left; }
+			const Accumulator& get_right() const { return right; }
+
+		private:
+			// The same conversion as the pack after the chain, so the compiler only does it once
+			static void accumulate(Accumulator& a, dsp::Sample sample) {
+				int32_t s = dsp::to_int16(sample);
+				a.sum += s;
+				a.squares += (uint32_t)(s * s);
+				a.peak = std::max(a.peak, s < 0 ? -s : s);
+				a.clips += s >= 32767 || s <= -32767;
+			}
+
+			Accumulator left = {};
+			Accumulator right = {};
+	};
+
+	// Adds a block to the current window, only called from the i2s task
+	void publish(const Meter& meter, size_t frames);
+
+	// Returns the levels since the previous snapshot and starts a new window
+	Snapshot get_snapshot();
+
+	// Cheap enough to poll, also true while nothing is played at all
+	bool silent();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ring_buffer.h"
+
+// Mixes prompts into the stereo stream right before it is written to i2s
+namespace mixer {
+	struct Voice;
+
+	// Claims a voice for a prompt with the given sample rate, returns nullptr if all voices are in use
+	Voice* acquire(uint32_t sample_rate);
+	// Space for stereo frames in the buffer of the voice, which can be filled in place before committing it
+	RingBuffer::Region reserve(Voice* voice, size_t length);
+	void commit(Voice* voice, size_t length);
+	// No more frames will be written, the voice is freed once everything has been played
+	void release(Voice* voice);
+	// Fades the voice out over the next block and frees it, no more frames should be written afterwards
+	void stop(Voice* voice);
+
+	// True while prompts are playing or the music is still ducked
+	bool active();
+	// Ducks the music and adds all active voices, resampled to the rate of the stream
+	void process(uint32_t* frames, size_t length, uint32_t sample_rate);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "riff.h"
+
+// Prompts are embedded in the app, a dedicated partition can replace them without reflashing the app
+namespace prompts {
+	// Maps the prompts partition, it stays mapped so prompts are played straight from flash
+	void init();
+
+	// Prompts in the partition take precedence over the embedded ones, returns an invalid wave if the prompt does not exist
+	riff::Wave find(const char* name);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ring_buffer.h"
+
+// Maximum amount of sample rate changes that can be queued
+#define RATE_CHANGES 4
+// Length of the fade around a sample rate change, about 3ms
+#define RATE_FADE_FRAMES 128
+
+// Sample rate changes in the stream, each one is tagged with the write position of the first frame at the new rate
+// The bluetooth stack pushes them, the i2s task only switches once everything in front of the change has been read
+class RateChanges {
+	public:
+		RateChanges() : buffer(storage, RATE_CHANGES * 2) {}
+
+		// Producer, returns false if too many changes are pending
+		bool push(uint32_t position, uint32_t rate);
+
+		// Consumer
+		// Frames that can still be read at the current rate, SIZE_MAX if no change is pending
+		size_t remaining(uint32_t read_position) const;
+		// Returns the new rate and removes the change once the read position got there, zero otherwise
+		uint32_t take(uint32_t read_position);
+
+	private:
+		// Each entry is the write position followed by the new sample rate
+		uint32_t storage[RATE_CHANGES * 2];
+		RingBuffer buffer;
+};
+
+// Fades out towards a pending sample rate change and back in after it, so reclocking i2s does not click
+class RateFade {
+	public:
+		// Remaining is the amount of input frames left at the current rate, ratio the input frames consumed per output frame
+		void apply(uint32_t* frames, size_t length, size_t remaining, float ratio);
+		// The frames after the change fade in
+		void restart() { fade_in = 0; }
+
+	private:
+		size_t fade_in = RATE_FADE_FRAMES;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ring_buffer.h"
+
+// Taps of the windowed sinc filter, the other interpolators use the middle of the same history
+#define RESAMPLER_TAPS 16
+// Amount of precomputed filter phases, intermediate phases are linearly interpolated
+#define RESAMPLER_PHASES 32
+
+// Fractional resampler for 16 bit stereo frames
+// The ratio is the amount of input frames consumed per output frame, so it can track small clock differences as well as convert between sample rates
+class Resampler {
+	public:
+		enum class Quality : uint8_t {
+			LINEAR,
+			// Catmull-Rom spline in Farrow form
+			CUBIC,
+			// Polyphase windowed sinc
+			SINC,
+		};
+
+		Resampler(Quality quality = Quality::CUBIC);
+
+		// Bandwidth that keeps the images and aliases out of the audible range for a given ratio
+		static float bandwidth_for(float ratio);
+
+		void set_ratio(float ratio) { step = ratio; }
+		float get_ratio() const { return step; }
+
+		// Cutoff of the sinc filter relative to the Nyquist frequency of the input, should be lowered when downsampling
+		// This recalculates the filter, so it should only be called when the sample rates change
+		void set_bandwidth(float bandwidth);
+		void set_quality(Quality quality);
+
+		// Reads from the buffer in place and stops early when the buffer runs dry or limit input frames have been consumed
+		size_t process(RingBuffer& input, uint32_t* output, size_t frames, size_t limit = SIZE_MAX);
+		void reset();
+
+	private:
+		template <Quality Q>
+		size_t run(RingBuffer& input, uint32_t* output, size_t frames, size_t limit);
+		size_t copy(RingBuffer& input, uint32_t* output, size_t frames, size_t limit);
+
+		void push(uint32_t frame);
+		template <Quality Q>
+		uint32_t interpolate() const;
+
+		Quality quality;
+		float step = 1;
+		// Position of the next output frame between the two frames in the middle of the history
+		float position = 0;
+
+		// The history is stored twice so the window is always contiguous
+		uint32_t history[RESAMPLER_TAPS * 2] = {};
+		size_t index = 0;
+
+		float coefficients[(RESAMPLER_PHASES + 1) * RESAMPLER_TAPS];
+};
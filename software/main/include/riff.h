@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Chunk walking RIFF/WAVE parser
+// Everything is constexpr, so embedded assets are validated at compile time and the same code checks assets loaded at runtime
+namespace riff {
+	enum Encoding : uint16_t {
+		PCM = 0x0001,
+		IMA_ADPCM = 0x0011,
+		// The actual encoding is stored in the sub format
+		EXTENSIBLE = 0xFFFE,
+	};
+
+	struct Format {
+		uint16_t encoding = 0;
+		uint16_t channels = 0;
+		uint32_t sample_rate = 0;
+		uint16_t block_align = 0;
+		uint16_t bits_per_sample = 0;
+		// Only used by IMA-ADPCM, includes the sample stored in the block header
+		uint16_t samples_per_block = 0;
+	};
+
+	struct Chunk {
+		const uint8_t* id;
+		const uint8_t* data;
+		uint32_t size;
+	};
+
+	// Points straight into the parsed data, nothing is copied
+	struct Wave {
+		Format format = {};
+		const uint8_t* data = nullptr;
+		uint32_t size = 0;
+		// Samples per channel
+		uint32_t samples = 0;
+		// Reason the file was rejected
+		const char* error = nullptr;
+
+		constexpr bool valid() const { return !error && data; }
+	};
+
+	// Everything is little endian and not necessarily aligned
+	constexpr uint16_t read_u16(const uint8_t* data) {
+		return data[0] | (data[1] << 8);
+	}
+
+	constexpr uint32_t read_u32(const uint8_t* data) {
+		return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+	}
+
+	constexpr bool match(const uint8_t* id, const char (&tag)[5]) {
+		for (int i = 0; i < 4; i++) {
+			if (id[i] != (uint8_t)tag[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Walks the chunks in a block of memory, a chunk that claims to be larger than what is left gets truncated
+	class Reader {
+		public:
+			constexpr Reader(const uint8_t* data, size_t size) : position(data), left(size) {}
+
+			constexpr bool next(Chunk& chunk) {
+				if (left < 8) {
+					return false;
+				}
+
+				uint32_t size = read_u32(position + 4);
+				if (size > left - 8) {
+					size = left - 8;
+				}
+				chunk = {position, position + 8, size};
+
+				// Chunks are padded to an even size
+				size_t advance = 8 + size + (size & 1);
+				if (advance > left) {
+					advance = left;
+				}
+				position += advance;
+				left -= advance;
+
+				return true;
+			}
+
+		private:
+			const uint8_t* position;
+			size_t left;
+	};
+
+	constexpr Wave invalid(const char* error) {
+		Wave wave;
+		wave.error = error;
+		return wave;
+	}
+
+	constexpr Wave parse(const uint8_t* data, size_t size) {
+		if (size < 12 || !match(data, "RIFF") || !match(data + 8, "WAVE")) {
+			return invalid("Not a RIFF/WAVE file");
+		}
+
+		// Trailing data after the RIFF chunk is ignored
+		size_t length = read_u32(data + 4);
+		if (length < 4) {
+			return invalid("Invalid RIFF size");
+		}
+		if (length > size - 8) {
+			length = size - 8;
+		}
+
+		Wave wave;
+		bool has_format = false;
+		uint32_t fact = 0;
+
+		Reader reader(data + 12, length - 4);
+		Chunk chunk = {};
+		while (reader.next(chunk)) {
+			if (match(chunk.id, "fmt ")) {
+				if (chunk.size < 16) {
+					return invalid("Format chunk is too small");
+				}
+
+				Format& format = wave.format;
+				format.encoding = read_u16(chunk.data);
+				format.channels = read_u16(chunk.data + 2);
+				format.sample_rate = read_u32(chunk.data + 4);
+				format.block_align = read_u16(chunk.data + 12);
+				format.bits_per_sample = read_u16(chunk.data + 14);
+
+				uint16_t extra = chunk.size >= 18 ? read_u16(chunk.data + 16) : 0;
+				if (format.encoding == EXTENSIBLE && extra >= 22 && chunk.size >= 26) {
+					format.encoding = read_u16(chunk.data + 24);
+				} else if (format.encoding == IMA_ADPCM && extra >= 2 && chunk.size >= 20) {
+					format.samples_per_block = read_u16(chunk.data + 18);
+				}
+
+				has_format = true;
+			} else if (match(chunk.id, "fact") && chunk.size >= 4) {
+				fact = read_u32(chunk.data);
+			} else if (match(chunk.id, "data")) {
+				wave.data = chunk.data;
+				wave.size = chunk.size;
+			}
+		}
+
+		if (!has_format) {
+			return invalid("Missing format chunk");
+		}
+		if (!wave.data) {
+			return invalid("Missing data chunk");
+		}
+
+		const Format& format = wave.format;
+		if (!format.channels || !format.sample_rate) {
+			return invalid("Invalid format");
+		}
+
+		if (format.encoding == PCM) {
+			if (format.bits_per_sample != 16 || format.block_align != 2 * format.channels) {
+				return invalid("Only 16 bit PCM is supported");
+			}
+
+			// A partial frame at the end is never read
+			wave.samples = wave.size / format.block_align;
+		} else if (format.encoding == IMA_ADPCM) {
+			// Every channel has a four byte header followed by groups of four bytes holding eight samples
+			uint32_t header = 4 * format.channels;
+			if (format.bits_per_sample != 4 || format.block_align <= header || (format.block_align - header) % header) {
+				return invalid("Invalid IMA-ADPCM block layout");
+			}
+
+			uint16_t expected = (format.block_align - header) * 2 / format.channels + 1;
+			if (format.samples_per_block && format.samples_per_block != expected) {
+				return invalid("Invalid IMA-ADPCM samples per block");
+			}
+			wave.format.samples_per_block = expected;
+
+			// The last block is allowed to be shorter, but only complete groups can be decoded
+			uint32_t blocks = wave.size / format.block_align;
+			uint32_t rest = wave.size % format.block_align;
+			wave.samples = blocks * expected;
+			if (rest >= header) {
+				wave.samples += (rest - header) / header * 8 + 1;
+			}
+		} else {
+			return invalid("Unsupported encoding");
+		}
+
+		// The fact chunk holds the actual length, the data might be padded to a full block
+		if (fact && fact < wave.samples) {
+			wave.samples = fact;
+		}
+
+		return wave;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "cache.h"
+
+// Lock-free single producer, single consumer buffer of 32-bit stereo frames
+// The producer reserves space, fills it in place and commits it, the consumer peeks at contiguous regions and releases them
+class RingBuffer {
+	public:
+		enum class Overflow : uint8_t {
+			// Drop the entire write if it does not fit
+			DROP,
+			// Write as much as fits and drop the rest
+			TRUNCATE,
+		};
+
+		// Space handed to the producer, the second part is only used when the reservation wraps around
+		struct Region {
+			uint32_t* first = nullptr;
+			size_t first_length = 0;
+			uint32_t* second = nullptr;
+			size_t second_length = 0;
+
+			size_t length() const { return first_length + second_length; }
+		};
+
+		struct Stats {
+			uint32_t written;
+			uint32_t read;
+			uint32_t dropped;
+			uint32_t overflows;
+			uint32_t underruns;
+		};
+
+		// The capacity has to be a power of two
+		RingBuffer(uint32_t* storage, size_t capacity, Overflow overflow = Overflow::DROP);
+
+		// Producer
+		Region reserve(size_t frames);
+		void commit(size_t frames);
+		size_t write(const void* frames, size_t length);
+
+		// Consumer
+		size_t peek(const uint32_t** data) const;
+		void release(size_t frames);
+		void underrun();
+
+		size_t available() const;
+		size_t space() const;
+		size_t capacity() const { return size; }
+
+		// Total amount of frames that have ever been committed and released, these wrap around
+		uint32_t write_position() const { return head.load(std::memory_order_acquire); }
+		uint32_t read_position() const { return tail.load(std::memory_order_acquire); }
+
+		Stats get_stats() const;
+
+	private:
+		uint32_t* const storage;
+		const size_t size;
+		const size_t mask;
+		const Overflow overflow;
+
+		// Separate cache lines keep the producer and consumer from invalidating each other
+		// Only written by the producer
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> head{0};
+		std::atomic<uint32_t> dropped{0};
+		std::atomic<uint32_t> overflows{0};
+
+		// Only written by the consumer
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> tail{0};
+		std::atomic<uint32_t> underruns{0};
+};
@@ -1,7 +1,38 @@
 #pragma once
 
+#include <cstdint>
+
 namespace twai {
+	struct Stats {
+		// Volume steps that were pressed and released
+		uint32_t steps;
+		// Steps that cancelled out against a step in the other direction before they were sent
+		uint32_t cancelled;
+		uint32_t frames;
+		uint32_t retries;
+		uint32_t failed;
+		// Times the controller went bus off and was recovered
+		uint32_t recoveries;
+
+		uint32_t received;
+		// Frames for one of our messages with the wrong length
+		uint32_t malformed;
+		// Frames the acceptance filter let through that the software filter dropped
+		uint32_t ignored;
+	};
+
 	void init();
+
+	// Queues a step, never blocks
 	void change_volume(bool up);
-}
+	// Queues several steps at once, positive is up, fails when the radio is not listening to us
+	bool step_volume(int32_t steps);
+	// Drops the steps that have not been sent yet and returns them, the press that is on the bus still goes through
+	int32_t cancel_volume();
+	// Steps that have not been sent yet, positive is up
+	int32_t get_pending_steps();
+	// Nothing queued and nothing on the bus
+	bool volume_idle();
 
+	Stats get_stats();
+}
@@ -3,10 +3,24 @@
 #include <cstdint>
 
 namespace volume_controller {
+	struct Stats {
+		// Times the radio had to follow the phone
+		uint32_t syncs;
+		// Syncs that were stopped by someone using the buttons or the knob
+		uint32_t interrupted;
+		// Steps the radio never reported
+		uint32_t lost;
+		// Time it took the radio to reach the target
+		uint32_t last_ms;
+		uint32_t max_ms;
+	};
+
 	void init();
 	void set_from_radio(int volume);
 	void set_from_remote(int volume);
 	void cancel_sync();
 
 	uint8_t current();
+
+	Stats get_stats();
 }
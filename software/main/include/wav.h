@@ -2,12 +2,16 @@
 
 #include <cstdint>
 
-#define WAV_PLAY(NAME) {\
-	extern const uint8_t _binary_ ## NAME ## _wav_start[]; \
-	extern const uint8_t _binary_ ## NAME ## _wav_end[]; \
-	wav::play(_binary_ ## NAME ## _wav_start, _binary_ ## NAME ## _wav_end); \
-}
+#define WAV_PLAY(NAME, PRIORITY) wav::play(#NAME, wav::Priority::PRIORITY)
 
 namespace wav {
-	void play(const uint8_t* start, const uint8_t* end);
+	enum Priority : uint8_t {
+		LOW,
+		NORMAL,
+		HIGH,
+	};
+
+	void init();
+	// Plays the prompt with the given name, see prompts::find
+	void play(const char* name, Priority priority = Priority::NORMAL);
 }
@@ -1,7 +1,12 @@
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_gap_bt_api.h"
 #include "esp_a2dp_api.h"
-#include "driver/i2s.h"
 
 #include "a2dp.h"
 #include "helper.h"
@@ -13,6 +18,47 @@
 
 #define A2DP_TAG "APP_A2DP"
 
+// How often the latency is checked, it only changes slowly as the buffer adapts
+#define DELAY_CHECK_MS 1000
+// Phones only resync the video on a change this large, in units of 0.1 ms
+#define DELAY_THRESHOLD 100
+
+static std::atomic<bool> connected{false};
+// Value the phone has been told, in units of 0.1 ms
+static std::atomic<uint16_t> reported_delay{0};
+enum class Answer : uint8_t {
+	PENDING,
+	ACCEPTED,
+	REJECTED,
+};
+// Not every phone supports delay reporting, once it rejects a report we stop sending them until the next connection
+// Answered on the callback task of bluedroid, read by the delay task
+static std::atomic<Answer> answer{Answer::PENDING};
+
+// AVDTP delay reporting, lets the phone delay the video by the same amount as the audio
+static void report_delay() {
+	uint16_t delay = std::min<uint32_t>(i2s::get_latency_us() / 100, UINT16_MAX);
+	answer.store(Answer::PENDING, std::memory_order_relaxed);
+	if (esp_a2d_sink_set_delay_value(delay) != ESP_OK) {
+		ESP_LOGE(A2DP_TAG, "esp_a2d_sink_set_delay_value failed");
+		return;
+	}
+
+	reported_delay.store(delay, std::memory_order_relaxed);
+}
+
+static void update_delay(void*) {
+	for (;;) {
+		vTaskDelay(pdMS_TO_TICKS(DELAY_CHECK_MS));
+
+		int32_t delay = i2s::get_latency_us() / 100;
+		bool rejected = answer.load(std::memory_order_relaxed) == Answer::REJECTED;
+		if (connected.load(std::memory_order_relaxed) && !rejected && abs(delay - reported_delay.load(std::memory_order_relaxed)) >= DELAY_THRESHOLD) {
+			report_delay();
+		}
+	}
+}
+
 static void handle_connection_state(uint16_t event, esp_a2d_cb_param_t* a2d) {
 	ESP_LOGI(A2DP_TAG, "partner address: %s", addr_to_str(a2d->conn_stat.remote_bda));
 
@@ -23,6 +69,7 @@ static void handle_connection_state(uint16_t event, esp_a2d_cb_param_t* a2d) {
 	if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
 		ESP_LOGI(A2DP_TAG, "ESP_A2D_CONNECTION_STATE_DISCONNECTED");
 		leds::set_bluetooth(leds::Bluetooth::DISCONNECTED);
+		connected.store(false, std::memory_order_relaxed);
 
 		if (a2d->conn_stat.disc_rsn == ESP_A2D_DISC_RSN_ABNORMAL && retry_count < 3) {
 				ESP_LOGI(A2DP_TAG,"Connection try number: %d", retry_count);
@@ -32,7 +79,7 @@ static void handle_connection_state(uint16_t event, esp_a2d_cb_param_t* a2d) {
 			bluetooth::set_scan_mode(true);
 
 			if (was_connected) {
-				WAV_PLAY(disconnect);
+				WAV_PLAY(disconnect, NORMAL);
 			}
 		}
 	} else if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_CONNECTED){
@@ -43,7 +90,10 @@ static void handle_connection_state(uint16_t event, esp_a2d_cb_param_t* a2d) {
 		retry_count = 0;
 		was_connected = true;
 
-		WAV_PLAY(connect);
+		WAV_PLAY(connect, NORMAL);
+
+		connected.store(true, std::memory_order_relaxed);
+		report_delay();
 
 		// record current connection
 		nvs::set_last_connection(a2d->conn_stat.remote_bda);
@@ -89,6 +139,16 @@ static void a2d_callback(esp_a2d_cb_event_t event, esp_a2d_cb_param_t* a2d) {
 			handle_audio_cfg(event, a2d);
 			break;
 
+		case ESP_A2D_SNK_SET_DELAY_VALUE_EVT:
+			if (a2d->a2d_set_delay_value_stat.set_state == ESP_A2D_SET_SUCCESS) {
+				answer.store(Answer::ACCEPTED, std::memory_order_relaxed);
+				ESP_LOGI(A2DP_TAG, "Reported a delay of %u.%u ms", a2d->a2d_set_delay_value_stat.delay_value / 10, a2d->a2d_set_delay_value_stat.delay_value % 10);
+			} else {
+				answer.store(Answer::REJECTED, std::memory_order_relaxed);
+				ESP_LOGW(A2DP_TAG, "Delay of %u was not accepted, not reporting it again", a2d->a2d_set_delay_value_stat.delay_value);
+			}
+			break;
+
 		case ESP_A2D_PROF_STATE_EVT:
 			if (ESP_A2D_INIT_SUCCESS == a2d->a2d_prof_stat.init_state) {
 				ESP_LOGI(A2DP_TAG,"A2DP PROF STATE: Init Compl\n");
@@ -103,43 +163,9 @@ static void a2d_callback(esp_a2d_cb_event_t event, esp_a2d_cb_param_t* a2d) {
 	}
 }
 
-/**
- * @brief Utility structure that can be used to split a int32_t up into 2 separate channels with int16_t data.
- * @author Phil Schatzmann
- * @copyright Apache License Version 2
- */
-struct __attribute__((packed)) Frame {
-  int16_t channel1;
-  int16_t channel2;
-
-  Frame(int v=0){
-    channel1 = channel2 = v;
-  }
-
-  Frame(int ch1, int ch2){
-    channel1 = ch1;
-    channel2 = ch2;
-  }
-
-};
-
+// Channel swapping and the other kernels are applied right before i2s, after the prompts have been mixed in
 static void audio_data_callback(const uint8_t* data, uint32_t len) {
 	i2s::write(data, len);
-	/* Frame* frame = (Frame*)data; */
-	/* for (int i = 0; i < len/4; i++) { */
-	/* 	int16_t temp = frame[i].channel1; */
-	/* 	frame[i].channel1 = frame[i].channel2; */
-	/* 	frame[i].channel2 = temp; */
-	/* } */
-
-	/* size_t bytes_written; */
-	/* if (i2s_write(I2S_PORT, data, len, &bytes_written, portMAX_DELAY) != ESP_OK) { */
-	/* 	ESP_LOGE(A2DP_TAG, "i2s_write has failed"); */
-	/* } */
-
-	/* if (bytes_written < len) { */
-	/* 	ESP_LOGE(A2DP_TAG, "Timeout: not all bytes were written to I2S"); */
-	/* } */
 }
 
 void a2dp::init() {
@@ -155,6 +181,8 @@ void a2dp::init() {
 	if (esp_a2d_sink_init() != ESP_OK){
 		ESP_LOGE(A2DP_TAG,"esp_a2d_sink_init failed");
 	}
+
+	xTaskCreatePinnedToCore(update_delay, "Delay report", 2048, nullptr, 0, nullptr, 0);
 }
 
 void a2dp::connect_to_last() {
@@ -169,3 +197,6 @@ void a2dp::connect_to_last() {
 	}
 }
 
+uint32_t a2dp::get_reported_delay_us() {
+	return answer.load(std::memory_order_relaxed) == Answer::ACCEPTED ? reported_delay.load(std::memory_order_relaxed) * 100 : 0;
+}
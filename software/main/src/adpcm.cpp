@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include "adpcm.h"
+
+static const int8_t index_table[16] = {
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static const int16_t step_table[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+	253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+	1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+	3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+	11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+	32767,
+};
+
+void adpcm::Decoder::open(const riff::Wave& wave) {
+	block = wave.data;
+	samples = wave.samples;
+	samples_per_block = wave.format.samples_per_block;
+	block_align = wave.format.block_align;
+	channels = wave.format.channels;
+	position = 0;
+}
+
+int16_t adpcm::Decoder::expand(Channel& channel, uint8_t nibble) {
+	int32_t step = step_table[channel.index];
+	int32_t delta = step >> 3;
+	if (nibble & 4) {
+		delta += step;
+	}
+	if (nibble & 2) {
+		delta += step >> 1;
+	}
+	if (nibble & 1) {
+		delta += step >> 2;
+	}
+
+	channel.predictor = std::clamp<int32_t>(nibble & 8 ? channel.predictor - delta : channel.predictor + delta, -32768, 32767);
+	channel.index = std::clamp<int32_t>(channel.index + index_table[nibble], 0, 88);
+
+	return channel.predictor;
+}
+
+size_t adpcm::Decoder::decode(uint32_t* frames, size_t length) {
+	length = std::min(length, (size_t)samples);
+	int decoded = std::min<uint16_t>(channels, 2);
+
+	for (size_t i = 0; i < length; i++) {
+		if (position == samples_per_block) {
+			block += block_align;
+			position = 0;
+		}
+
+		// Silence if the stream has no channels at all
+		int16_t sample[2] = {};
+		for (int c = 0; c < decoded; c++) {
+			Channel& channel = state[c];
+			if (position == 0) {
+				// The first sample of every block is stored as is
+				const uint8_t* header = block + 4 * c;
+				channel.predictor = (int16_t)riff::read_u16(header);
+				channel.index = std::min<int32_t>(header[2], 88);
+				sample[c] = channel.predictor;
+			} else {
+				// After the headers the channels alternate in groups of four bytes holding eight samples
+				uint16_t k = position - 1;
+				uint8_t byte = block[4 * channels + (k / 8) * 4 * channels + 4 * c + (k % 8) / 2];
+				sample[c] = expand(channel, k & 1 ? byte >> 4 : byte & 0x0F);
+			}
+		}
+		position++;
+
+		uint16_t left = (uint16_t)sample[0];
+		uint16_t right = decoded == 2 ? (uint16_t)sample[1] : left;
+		frames[i] = left | ((uint32_t)right << 16);
+	}
+
+	samples -= length;
+	return length;
+}
@@ -0,0 +1,68 @@
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+
+#include "esp_log.h"
+#include "soc/rtc.h"
+#include "soc/soc_caps.h"
+
+#include "apll.h"
+
+#define APLL_TAG "APP_APLL"
+
+// The i2s driver is configured for this, it derives the master clock from the sample rate
+#define MCLK_MULTIPLE 256
+
+static apll::Trim trimmer;
+// Frequency the driver programmed for the nominal sample rate, zero if we do not control the clock
+static uint32_t nominal = 0;
+static std::atomic<int32_t> ppm{0};
+
+// Same as the i2s driver, the APLL runs at a multiple of the master clock that is at least two
+static uint32_t frequency_for(uint32_t sample_rate) {
+	uint32_t mclk = sample_rate * MCLK_MULTIPLE;
+	uint32_t div = std::max<uint32_t>(2, SOC_APLL_MIN_HZ / mclk + 1);
+	return mclk * div;
+}
+
+static bool program(uint32_t frequency) {
+	uint32_t o_div, sdm0, sdm1, sdm2;
+	if (!rtc_clk_apll_coeff_calc(frequency, &o_div, &sdm0, &sdm1, &sdm2)) {
+		return false;
+	}
+
+	rtc_clk_apll_coeff_set(o_div, sdm0, sdm1, sdm2);
+	return true;
+}
+
+bool apll::start(uint32_t sample_rate) {
+	nominal = frequency_for(sample_rate);
+	trimmer.reset();
+	ppm.store(0, std::memory_order_relaxed);
+
+	if (nominal > SOC_APLL_MAX_HZ || !program(nominal)) {
+		ESP_LOGW(APLL_TAG, "Can not steer the clock at %u Hz, falling back to resampling", sample_rate);
+		nominal = 0;
+		return false;
+	}
+
+	ESP_LOGI(APLL_TAG, "Steering the clock at %u Hz with the APLL at %u Hz", sample_rate, nominal);
+	return true;
+}
+
+void apll::trim(float ratio) {
+	if (!nominal || !trimmer.update(ratio)) {
+		return;
+	}
+
+	// The step is much smaller than what would change the output divider, so this does not glitch
+	if (!program((uint32_t)lrint(nominal * (double)trimmer.get_ratio()))) {
+		ESP_LOGE(APLL_TAG, "Failed to trim the clock to %d ppm", trimmer.get_ppm());
+		return;
+	}
+	ppm.store(trimmer.get_ppm(), std::memory_order_relaxed);
+}
+
+int32_t apll::get_ppm() {
+	return ppm.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,202 @@
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+
+#include "audio.h"
+#include "dsp.h"
+#include "eq.h"
+#include "loudness.h"
+#include "limiter.h"
+#include "meter.h"
+#include "i2s.h"
+#include "extremes.h"
+
+#define AUDIO_TAG "APP_AUDIO"
+
+#ifdef CONFIG_CAR_STEREO_EQ
+	#define EQ_ENABLED true
+#else
+	#define EQ_ENABLED false
+#endif
+
+#ifdef CONFIG_CAR_STEREO_LOUDNESS
+	#define LOUDNESS_ENABLED true
+#else
+	#define LOUDNESS_ENABLED false
+#endif
+
+#ifdef CONFIG_CAR_STEREO_LIMITER
+	#define LIMITER_ENABLED true
+#else
+	#define LIMITER_ENABLED false
+#endif
+
+#if defined(CONFIG_CAR_STEREO_EQ_PRESET_CABIN)
+	#define EQ_PRESET eq::Preset::CABIN
+#elif defined(CONFIG_CAR_STEREO_EQ_PRESET_BASS)
+	#define EQ_PRESET eq::Preset::BASS
+#elif defined(CONFIG_CAR_STEREO_EQ_PRESET_VOICE)
+	#define EQ_PRESET eq::Preset::VOICE
+#else
+	#define EQ_PRESET eq::Preset::FLAT
+#endif
+
+using Equalizer = dsp::Optional<EQ_ENABLED, eq::Equalizer<EQ_BANDS>>;
+using Loudness = dsp::Optional<LOUDNESS_ENABLED, loudness::Loudness>;
+using Limiter = dsp::Optional<LIMITER_ENABLED, limiter::Limiter>;
+// The limiter comes after everything that can add gain, the mute fades out of its delay line
+// The meter is last so it sees exactly what goes out
+using Chain = dsp::Chain<Equalizer, Loudness, dsp::Gain, Limiter, dsp::Mute, meter::Meter>;
+
+static Chain chain;
+
+// Written from other tasks, the i2s task picks the changes up at the start of every block
+static std::atomic<float> gain{1.f};
+static std::atomic<eq::Preset> preset{EQ_PRESET};
+// Until we hear from the radio there is no compensation
+static std::atomic<uint8_t> radio_volume{LOUDNESS_STEPS - 1};
+static std::atomic<bool> muted{false};
+// Time the mute was requested, zero once the output is silent
+static std::atomic<int64_t> mute_requested{0};
+
+// Written by the i2s task and read by the stats task, every field on its own
+static std::atomic<uint32_t> chain_cycles{0};
+static std::atomic<uint32_t> chain_frames{0};
+static std::atomic<uint32_t> chain_latency_us{0};
+static std::atomic<uint32_t> mute_latency_us{0};
+static std::atomic<uint32_t> mute_latency_max_us{0};
+static std::atomic<uint32_t> mutes{0};
+// The extremes are raised by the i2s task and reset by the reader with an exchange
+static std::atomic<uint32_t> chain_cycles_max{0};
+static std::atomic<float> limiter_min_gain{1.f};
+
+#ifdef CONFIG_CAR_STEREO_EQ
+// What the equalizer is currently set up for
+static eq::Preset current_preset = eq::Preset::COUNT;
+static uint32_t current_rate = 0;
+
+static void update_equalizer(uint32_t sample_rate) {
+	eq::Preset p = preset.load(std::memory_order_relaxed);
+	Equalizer& equalizer = chain.get<Equalizer>();
+	if ((p == current_preset && sample_rate == current_rate) || equalizer.busy()) {
+		return;
+	}
+
+	equalizer.set(eq::get_bank(p, sample_rate));
+	current_preset = p;
+	current_rate = sample_rate;
+	ESP_LOGI(AUDIO_TAG, "Equalizer: %s at %u Hz", eq::get_name(p), sample_rate);
+}
+#endif
+
+#ifdef CONFIG_CAR_STEREO_LOUDNESS
+static uint8_t current_step = LOUDNESS_STEPS;
+static uint32_t current_loudness_rate = 0;
+
+static void update_loudness(uint32_t sample_rate) {
+	uint8_t step = radio_volume.load(std::memory_order_relaxed);
+	Loudness& loudness = chain.get<Loudness>();
+	if ((step == current_step && sample_rate == current_loudness_rate) || loudness.busy()) {
+		return;
+	}
+
+	loudness.set(loudness::get_bank(step, sample_rate));
+	current_step = step;
+	current_loudness_rate = sample_rate;
+}
+#endif
+
+void audio::init() {
+#ifdef CONFIG_CAR_STEREO_LIMITER
+	limiter::Settings settings;
+	settings.ceiling_db = CONFIG_CAR_STEREO_LIMITER_CEILING;
+#ifdef CONFIG_CAR_STEREO_COMPRESSOR
+	settings.threshold_db = CONFIG_CAR_STEREO_COMPRESSOR_THRESHOLD;
+	settings.ratio = CONFIG_CAR_STEREO_COMPRESSOR_RATIO;
+#endif
+	chain.get<Limiter>().configure(settings);
+
+	ESP_LOGI(AUDIO_TAG, "Limiter: ceiling %d dBFS, %u frames look ahead", CONFIG_CAR_STEREO_LIMITER_CEILING, LIMITER_LOOKAHEAD_FRAMES);
+#endif
+}
+
+void audio::process(uint32_t* frames, size_t length, uint32_t sample_rate) {
+#ifdef CONFIG_CAR_STEREO_EQ
+	update_equalizer(sample_rate);
+#endif
+#ifdef CONFIG_CAR_STEREO_LOUDNESS
+	update_loudness(sample_rate);
+#endif
+	chain.get<dsp::Gain>().set(gain.load(std::memory_order_relaxed));
+	chain.get<dsp::Mute>().set(muted.load(std::memory_order_relaxed));
+
+	uint32_t start = esp_cpu_get_cycle_count();
+	chain.process(frames, length);
+	uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+	meter::publish(chain.get<meter::Meter>(), length);
+
+	chain_cycles.store(cycles, std::memory_order_relaxed);
+	extremes::raise(chain_cycles_max, cycles);
+	chain_frames.store(length, std::memory_order_relaxed);
+#ifdef CONFIG_CAR_STEREO_LIMITER
+	extremes::lower(limiter_min_gain, chain.get<Limiter>().take_min_gain());
+	chain_latency_us.store((uint64_t)LIMITER_LOOKAHEAD_FRAMES * 1000000 / sample_rate, std::memory_order_relaxed);
+#endif
+
+	// The block still has to wait for everything that is already queued for i2s
+	int64_t requested = mute_requested.load(std::memory_order_relaxed);
+	if (requested && chain.get<dsp::Mute>().silent()) {
+		int64_t queued = (int64_t)(i2s::get_queued_frames() + length) * 1000000 / sample_rate;
+		uint32_t latency = esp_timer_get_time() - requested + queued;
+
+		// Only this task writes them, so the max and the count do not need a read modify write
+		mute_latency_us.store(latency, std::memory_order_relaxed);
+		mute_latency_max_us.store(std::max(mute_latency_max_us.load(std::memory_order_relaxed), latency), std::memory_order_relaxed);
+		mutes.store(mutes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		mute_requested.store(0, std::memory_order_relaxed);
+	}
+}
+
+void audio::set_muted(bool m) {
+	if (m && !muted.load(std::memory_order_relaxed)) {
+		mute_requested.store(esp_timer_get_time(), std::memory_order_relaxed);
+	} else if (!m) {
+		mute_requested.store(0, std::memory_order_relaxed);
+	}
+	muted.store(m, std::memory_order_relaxed);
+}
+
+uint32_t audio::get_latency_us() {
+	return chain_latency_us.load(std::memory_order_relaxed);
+}
+
+audio::Stats audio::get_stats() {
+	audio::Stats s = {
+		.mute_latency_us = mute_latency_us.load(std::memory_order_relaxed),
+		.mute_latency_max_us = mute_latency_max_us.load(std::memory_order_relaxed),
+		.mutes = mutes.load(std::memory_order_relaxed),
+		.cycles = chain_cycles.load(std::memory_order_relaxed),
+		.cycles_max = chain_cycles_max.exchange(0, std::memory_order_relaxed),
+		.frames = chain_frames.load(std::memory_order_relaxed),
+		.latency_us = chain_latency_us.load(std::memory_order_relaxed),
+		.limiter_reduction_db = -20.f * log10f(limiter_min_gain.exchange(1.f, std::memory_order_relaxed)),
+	};
+	return s;
+}
+
+void audio::set_gain(float g) {
+	gain.store(g, std::memory_order_relaxed);
+}
+
+void audio::set_preset(eq::Preset p) {
+	preset.store(p, std::memory_order_relaxed);
+}
+
+void audio::set_radio_volume(uint8_t volume) {
+	radio_volume.store(volume, std::memory_order_relaxed);
+}
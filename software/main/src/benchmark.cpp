@@ -0,0 +1,333 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+
+#include "benchmark.h"
+#include "ring_buffer.h"
+#include "resampler.h"
+#include "adpcm.h"
+#include "prompts.h"
+#include "kernels.h"
+#include "dsp.h"
+#include "eq.h"
+#include "limiter.h"
+#include "meter.h"
+
+#define BENCHMARK_TAG "APP_BENCHMARK"
+
+#define BENCHMARK_ITERATIONS 1000
+#define BENCHMARK_BUFFER_FRAMES (4 * 1024)
+// A typical decoded SBC packet
+#define BENCHMARK_PACKET_FRAMES 128
+
+static void report(const char* name, uint32_t cycles, uint32_t frames) {
+	ESP_LOGI(BENCHMARK_TAG, "%s: %u cycles/frame (x100)", name, (uint32_t)((uint64_t)cycles * 100 / frames));
+}
+
+static void ring_buffer() {
+	static uint32_t packet[BENCHMARK_PACKET_FRAMES];
+	static uint32_t storage[BENCHMARK_BUFFER_FRAMES];
+	RingBuffer buffer(storage, BENCHMARK_BUFFER_FRAMES);
+
+	uint32_t start = esp_cpu_get_cycle_count();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		buffer.write(packet, BENCHMARK_PACKET_FRAMES);
+
+		const uint32_t* data;
+		size_t frames;
+		while ((frames = buffer.peek(&data))) {
+			buffer.release(frames);
+		}
+	}
+	report("RingBuffer", esp_cpu_get_cycle_count() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+}
+
+static void xringbuffer() {
+	static uint32_t packet[BENCHMARK_PACKET_FRAMES];
+	RingbufHandle_t buffer = xRingbufferCreate(BENCHMARK_BUFFER_FRAMES * sizeof(uint32_t), RINGBUF_TYPE_BYTEBUF);
+	if (!buffer) {
+		ESP_LOGE(BENCHMARK_TAG, "Failed to create ringbuffer");
+		return;
+	}
+
+	uint32_t start = esp_cpu_get_cycle_count();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		xRingbufferSend(buffer, packet, sizeof(packet), 0);
+
+		size_t length;
+		void* data;
+		while ((data = xRingbufferReceive(buffer, &length, 0))) {
+			vRingbufferReturnItem(buffer, data);
+		}
+	}
+	report("xRingbuffer", esp_cpu_get_cycle_count() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+
+	vRingbufferDelete(buffer);
+}
+
+static void resampler(Resampler::Quality quality, const char* name, uint32_t input_rate, uint32_t output_rate) {
+	static uint32_t output[BENCHMARK_PACKET_FRAMES];
+	static uint32_t storage[BENCHMARK_BUFFER_FRAMES];
+	RingBuffer buffer(storage, BENCHMARK_BUFFER_FRAMES);
+
+	static Resampler resampler;
+	resampler.reset();
+	resampler.set_quality(quality);
+	float ratio = (float)input_rate / output_rate;
+	resampler.set_ratio(ratio);
+	resampler.set_bandwidth(Resampler::bandwidth_for(ratio));
+
+	uint32_t cycles = 0;
+	uint32_t frames = 0;
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		RingBuffer::Region region = buffer.reserve(buffer.space());
+		buffer.commit(region.length());
+
+		uint32_t start = esp_cpu_get_cycle_count();
+		frames += resampler.process(buffer, output, BENCHMARK_PACKET_FRAMES);
+		cycles += esp_cpu_get_cycle_count() - start;
+	}
+
+	char label[48];
+	snprintf(label, sizeof(label), "Resampler %s %u -> %u", name, input_rate, output_rate);
+	report(label, cycles, frames);
+}
+
+static void resampler() {
+	const uint32_t input_rates[] = {16000, 32000, 44100, 48000};
+	const uint32_t output_rates[] = {44100, 48000};
+
+	for (uint32_t output_rate : output_rates) {
+		for (uint32_t input_rate : input_rates) {
+			resampler(Resampler::Quality::LINEAR, "linear", input_rate, output_rate);
+			resampler(Resampler::Quality::CUBIC, "cubic", input_rate, output_rate);
+			resampler(Resampler::Quality::SINC, "sinc", input_rate, output_rate);
+		}
+	}
+}
+
+static void adpcm_decode() {
+	static uint32_t output[BENCHMARK_PACKET_FRAMES];
+
+	riff::Wave wave = prompts::find("connect");
+	if (wave.format.encoding != riff::IMA_ADPCM) {
+		return;
+	}
+
+	adpcm::Decoder decoder;
+	decoder.open(wave);
+
+	uint32_t frames = 0;
+	uint32_t start = esp_cpu_get_cycle_count();
+	while (decoder.remaining()) {
+		frames += decoder.decode(output, BENCHMARK_PACKET_FRAMES);
+	}
+	report("ADPCM decode", esp_cpu_get_cycle_count() - start, frames);
+}
+
+// The way the channels used to be handled, every frame split into a struct
+struct __attribute__((packed)) Frame {
+	int16_t channel1;
+	int16_t channel2;
+};
+
+static void naive_swap(uint32_t* frames, size_t length) {
+	Frame* frame = (Frame*)frames;
+	for (size_t i = 0; i < length; i++) {
+		int16_t temp = frame[i].channel1;
+		frame[i].channel1 = frame[i].channel2;
+		frame[i].channel2 = temp;
+	}
+}
+
+static void naive_downmix(uint32_t* frames, size_t length) {
+	Frame* frame = (Frame*)frames;
+	for (size_t i = 0; i < length; i++) {
+		int16_t mono = (frame[i].channel1 + frame[i].channel2) / 2;
+		frame[i].channel1 = mono;
+		frame[i].channel2 = mono;
+	}
+}
+
+static void naive_invert(uint32_t* frames, size_t length) {
+	Frame* frame = (Frame*)frames;
+	for (size_t i = 0; i < length; i++) {
+		frame[i].channel1 = -frame[i].channel1;
+		frame[i].channel2 = -frame[i].channel2;
+	}
+}
+
+static void naive_expand(const uint32_t* input, uint32_t* output, size_t length) {
+	const Frame* frame = (const Frame*)input;
+	int32_t* samples = (int32_t*)output;
+	for (size_t i = 0; i < length; i++) {
+		samples[2 * i] = frame[i].channel1 << 16;
+		samples[2 * i + 1] = frame[i].channel2 << 16;
+	}
+}
+
+static void kernel(const char* name, void (*f)(uint32_t*, size_t)) {
+	static uint32_t frames[BENCHMARK_PACKET_FRAMES];
+
+	uint32_t start = esp_cpu_get_cycle_count();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		f(frames, BENCHMARK_PACKET_FRAMES);
+	}
+	report(name, esp_cpu_get_cycle_count() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+}
+
+static void kernel(const char* name, void (*f)(const uint32_t*, uint32_t*, size_t)) {
+	static uint32_t frames[BENCHMARK_PACKET_FRAMES];
+	static uint32_t output[BENCHMARK_PACKET_FRAMES * 2];
+
+	uint32_t start = esp_cpu_get_cycle_count();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		f(frames, output, BENCHMARK_PACKET_FRAMES);
+	}
+	report(name, esp_cpu_get_cycle_count() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+}
+
+static void channel_kernels() {
+	kernel("Swap naive", naive_swap);
+	kernel("Swap", kernels::swap);
+	kernel("Downmix naive", naive_downmix);
+	kernel("Downmix", kernels::downmix);
+	kernel("Invert naive", naive_invert);
+	kernel("Invert", kernels::invert);
+	kernel("Expand naive", naive_expand);
+	kernel("Expand", kernels::expand);
+}
+
+// The same stages, once fused into a single pass and once as separate passes over the block
+static void chain() {
+	static uint32_t frames[BENCHMARK_PACKET_FRAMES];
+
+	static dsp::Chain<dsp::Gain, dsp::Swap, dsp::Invert> fused;
+	fused.get<dsp::Gain>().set(0.5f);
+
+	uint32_t start = esp_cpu_get_cycle_count();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		fused.process(frames, BENCHMARK_PACKET_FRAMES);
+	}
+	report("Chain fused", esp_cpu_get_cycle_count() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+
+	static dsp::Chain<dsp::Gain> gain;
+	static dsp::Chain<dsp::Swap> swap;
+	static dsp::Chain<dsp::Invert> invert;
+	gain.get<dsp::Gain>().set(0.5f);
+
+	start = esp_cpu_get_cycle_count();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		gain.process(frames, BENCHMARK_PACKET_FRAMES);
+		swap.process(frames, BENCHMARK_PACKET_FRAMES);
+		invert.process(frames, BENCHMARK_PACKET_FRAMES);
+	}
+	report("Chain sequential", esp_cpu_get_cycle_count() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+}
+
+template <size_t N>
+static void equalizer() {
+	static uint32_t frames[BENCHMARK_PACKET_FRAMES];
+	static dsp::Chain<eq::Equalizer<N>> chain;
+
+	eq::Bank<N> bank;
+	for (size_t i = 0; i < N; i++) {
+		bank[i] = eq::design(eq::Band{eq::Type::PEAKING, 1000.f, -3.f, 1.f}, 44100);
+	}
+	chain.template get<eq::Equalizer<N>>().set(bank);
+
+	// Skip the crossfade, it only happens when the coefficients change
+	for (size_t i = 0; i < EQ_CROSSFADE_FRAMES; i += BENCHMARK_PACKET_FRAMES) {
+		chain.process(frames, BENCHMARK_PACKET_FRAMES);
+	}
+
+	uint32_t start = esp_cpu_get_cycle_count();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		chain.process(frames, BENCHMARK_PACKET_FRAMES);
+	}
+
+	char label[32];
+	snprintf(label, sizeof(label), "Equalizer %u bands", N);
+	report(label, esp_cpu_get_cycle_count() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+}
+
+// The difference between the runs is the cost of a band, compare it to the cycles per frame available at 48 kHz
+static void equalizer() {
+	ESP_LOGI(BENCHMARK_TAG, "Budget at 48 kHz: %u cycles/frame", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000000 / 48000);
+	equalizer<1>();
+	equalizer<2>();
+	equalizer<4>();
+	equalizer<8>();
+}
+
+// Drives the limiter with a full scale signal that has peaks well above the ceiling, and checks it never lets one through
+static void peak_limiter() {
+	static uint32_t frames[BENCHMARK_PACKET_FRAMES];
+	static dsp::Chain<limiter::Limiter> chain;
+
+	limiter::Settings settings;
+	settings.ceiling_db = -1;
+	settings.threshold_db = -18;
+	settings.ratio = 3;
+	chain.get<limiter::Limiter>().configure(settings);
+
+	int16_t ceiling = (int16_t)(32767 * powf(10.f, settings.ceiling_db / 20.f)) + 1;
+	uint32_t over = 0;
+	uint32_t cycles = 0;
+	uint32_t seed = 1;
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		for (size_t j = 0; j < BENCHMARK_PACKET_FRAMES; j++) {
+			seed = seed * 1664525 + 1013904223;
+			// Mostly a quiet signal with the occasional full scale spike
+			int16_t sample = ((seed >> 12) & 0xF) ? (int16_t)(((seed >> 20) & 0xFFF) - 2048) : (int16_t)(seed >> 16);
+			frames[j] = (uint16_t)sample * 0x00010001u;
+		}
+
+		uint32_t start = esp_cpu_get_cycle_count();
+		chain.process(frames, BENCHMARK_PACKET_FRAMES);
+		cycles += esp_cpu_get_cycle_count() - start;
+
+		for (size_t j = 0; j < BENCHMARK_PACKET_FRAMES; j++) {
+			over += abs((int16_t)frames[j]) > ceiling || abs((int16_t)(frames[j] >> 16)) > ceiling;
+		}
+	}
+
+	report("Limiter", cycles, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+	ESP_LOGI(BENCHMARK_TAG, "Limiter: %u cycles/block, %u us latency at 44.1 kHz, %u frames over the ceiling",
+			cycles / BENCHMARK_ITERATIONS, LIMITER_LOOKAHEAD_FRAMES * 1000000 / 44100, over);
+}
+
+// Has to stay well under 1% of a core, which is about 33 cycles/frame at 48 kHz
+static void level_meter() {
+	static uint32_t frames[BENCHMARK_PACKET_FRAMES];
+	static dsp::Chain<meter::Meter> chain;
+
+	for (size_t i = 0; i < BENCHMARK_PACKET_FRAMES; i++) {
+		frames[i] = i * 0x01230123u;
+	}
+
+	uint32_t start = esp_cpu_get_cycle_count();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		chain.process(frames, BENCHMARK_PACKET_FRAMES);
+	}
+	report("Meter (with unpack and pack)", esp_cpu_get_cycle_count() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+}
+
+void benchmark::run() {
+	ESP_LOGI(BENCHMARK_TAG, "Running benchmarks");
+
+	ring_buffer();
+	xringbuffer();
+	resampler();
+	adpcm_decode();
+	channel_kernels();
+	chain();
+	equalizer();
+	peak_limiter();
+	level_meter();
+}
@@ -0,0 +1,36 @@
+#include <algorithm>
+
+#include "drift.h"
+
+// Smoothing of the fill level, bluetooth packets arrive in bursts so the raw fill level is very noisy
+#define DRIFT_SMOOTHING 0.01f
+
+DriftController::DriftController(float kp, float ki, float limit) : kp(kp), ki(ki), limit(limit) {}
+
+void DriftController::set_target(size_t frames) {
+	target = frames;
+}
+
+float DriftController::update(size_t fill) {
+	if (!primed) {
+		filtered = fill;
+		primed = true;
+	} else {
+		filtered += (fill - filtered) * DRIFT_SMOOTHING;
+	}
+
+	float error = filtered - target;
+
+	// The integral term converges to the actual clock offset between the phone and us
+	// Clamping it prevents windup while the buffer is filling up or running dry
+	integral = std::clamp(integral + ki * error, -limit, limit);
+	ratio = 1 + std::clamp(kp * error + integral, -limit, limit);
+
+	return ratio;
+}
+
+void DriftController::reset() {
+	integral = 0;
+	ratio = 1;
+	primed = false;
+}
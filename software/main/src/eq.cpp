@@ -0,0 +1,34 @@
+#include "eq.h"
+
+static constexpr uint32_t rates[] = {16000, 32000, 44100, 48000};
+static constexpr size_t RATE_COUNT = sizeof(rates) / sizeof(rates[0]);
+
+using Banks = std::array<std::array<eq::Bank<EQ_BANDS>, RATE_COUNT>, (size_t)eq::Preset::COUNT>;
+
+static constexpr Banks design_banks() {
+	Banks banks = {};
+	for (size_t preset = 0; preset < (size_t)eq::Preset::COUNT; preset++) {
+		for (size_t rate = 0; rate < RATE_COUNT; rate++) {
+			banks[preset][rate] = eq::design((eq::Preset)preset, rates[rate]);
+		}
+	}
+	return banks;
+}
+
+// Designed by the compiler, so they live in flash and switching presets only copies coefficients
+static constexpr Banks banks = design_banks();
+
+eq::Bank<EQ_BANDS> eq::get_bank(Preset preset, uint32_t sample_rate) {
+	for (size_t rate = 0; rate < RATE_COUNT; rate++) {
+		if (rates[rate] == sample_rate) {
+			return banks[(size_t)preset][rate];
+		}
+	}
+
+	// Only happens with an unusual fixed output rate
+	return design(preset, sample_rate);
+}
+
+const char* eq::get_name(Preset preset) {
+	return presets[(size_t)preset].name;
+}
@@ -1,38 +1,381 @@
+#include <atomic>
+#include <algorithm>
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/ringbuf.h"
+#include "freertos/queue.h"
+#include "sys/lock.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
 #include "driver/i2s.h"
 
 #include "i2s.h"
 #include "config.h"
+#include "ring_buffer.h"
+#include "resampler.h"
+#include "rate_changes.h"
+#include "drift.h"
+#include "jitter.h"
+#include "apll.h"
+#include "mixer.h"
+#include "kernels.h"
+#include "audio.h"
+#include "extremes.h"
 
 #define I2S_TAG "APP_I2S"
 
-#define RINGBUF_SIZE (16 * 1024)
+#define RINGBUF_FRAMES (4 * 1024)
 #define AUDIO_SAMPLE_SIZE (16 * 2 / 8) // 16bit, 2ch, 8bit/byte
+// Amount of frames we process and hand to i2s_write at once
+#define I2S_BLOCK_FRAMES CONFIG_CAR_STEREO_BLOCK_FRAMES
+// The output task only expands the block and waits on i2s, the processing task is sized from the configuration
+#define OUTPUT_STACK 3072
+// One block is processed while the other one is written
+#define PIPELINE_BLOCKS 2
+
+// Total amount of frames the DMA buffers can hold
+#define DMA_DESC_NUM 8
+#define DMA_FRAME_NUM 64
+#define DMA_FRAMES (DMA_DESC_NUM * DMA_FRAME_NUM)
+// The driver posts an event for every DMA buffer, leave room for a couple of rounds in case the tracking task is late
+#define EVENT_QUEUE_LENGTH (2 * DMA_DESC_NUM)
+
+// If no new data arrives while prebuffering we play what we have, otherwise the end of a stream would never be played
+#define PREBUFFER_TIMEOUT_MS 20
+
+#if defined(CONFIG_CAR_STEREO_RESAMPLER_LINEAR)
+	#define RESAMPLER_QUALITY Resampler::Quality::LINEAR
+#elif defined(CONFIG_CAR_STEREO_RESAMPLER_SINC)
+	#define RESAMPLER_QUALITY Resampler::Quality::SINC
+#else
+	#define RESAMPLER_QUALITY Resampler::Quality::CUBIC
+#endif
+
+#if defined(CONFIG_CAR_STEREO_CHANNELS_STEREO)
+	#define CHANNELS kernels::Channels::STEREO
+#elif defined(CONFIG_CAR_STEREO_CHANNELS_MONO)
+	#define CHANNELS kernels::Channels::MONO
+#else
+	#define CHANNELS kernels::Channels::SWAPPED
+#endif
+
+#ifdef CONFIG_CAR_STEREO_INVERT_POLARITY
+	#define INVERTED true
+#else
+	#define INVERTED false
+#endif
+
+// Every frame takes two words when it is expanded to 32 bit
+#ifdef CONFIG_CAR_STEREO_I2S_32BIT
+	#define I2S_BITS 32
+#else
+	#define I2S_BITS 16
+#endif
+#define I2S_FRAME_WORDS (I2S_BITS / 16)
+
+#if defined(CONFIG_CAR_STEREO_LATENCY_LOW)
+	#define LATENCY Latency::LOW
+#elif defined(CONFIG_CAR_STEREO_LATENCY_ROBUST)
+	#define LATENCY Latency::ROBUST
+#else
+	#define LATENCY Latency::NORMAL
+#endif
+
+#ifdef CONFIG_CAR_STEREO_APLL
+	#define USE_APLL true
+#else
+	#define USE_APLL false
+#endif
+
+#ifdef CONFIG_CAR_STEREO_OVERFLOW_TRUNCATE
+	#define RINGBUF_OVERFLOW RingBuffer::Overflow::TRUNCATE
+#else
+	#define RINGBUF_OVERFLOW RingBuffer::Overflow::DROP
+#endif
+
+alignas(CACHE_LINE_SIZE) static uint32_t storage[RINGBUF_FRAMES];
+static RingBuffer ringbuffer(storage, RINGBUF_FRAMES, RINGBUF_OVERFLOW);
+static TaskHandle_t task_handle = nullptr;
+static TaskHandle_t output_handle = nullptr;
+
+static RateChanges rate_changes;
+
+// Sample rate of the incoming audio and the rate i2s is currently clocked at
+static uint32_t sample_rate = 44100;
+#ifdef CONFIG_CAR_STEREO_FIXED_OUTPUT_RATE
+static uint32_t output_rate = CONFIG_CAR_STEREO_OUTPUT_RATE;
+#else
+static uint32_t output_rate = 44100;
+#endif
+// Conversion ratio between the incoming audio and the output, the drift correction is applied on top of this
+static float nominal_ratio = (float)sample_rate / output_rate;
+
+static Resampler resampler(RESAMPLER_QUALITY);
+static DriftController drift(DRIFT_KP, DRIFT_KI, DRIFT_LIMIT);
+// The drift is absorbed by the clock instead of the resampler, when the APLL can be used at the current rate
+static bool steering = false;
+static uint32_t blocks[PIPELINE_BLOCKS][I2S_BLOCK_FRAMES];
+#ifdef CONFIG_CAR_STEREO_I2S_32BIT
+static uint32_t expanded[I2S_BLOCK_FRAMES * I2S_FRAME_WORDS];
+#endif
+
+// Only used from the bluetooth stack, the i2s task picks the target up at the start of every block
+static JitterEstimator jitter(I2S_BLOCK_FRAMES);
+static std::atomic<Latency> latency{LATENCY};
+static std::atomic<size_t> target{jitter.get_target(LATENCY)};
+// The estimator itself is not safe to read from other tasks
+static std::atomic<size_t> measured_jitter{0};
+
+static std::atomic<kernels::Channels> channels{CHANNELS};
+static std::atomic<bool> inverted{INVERTED};
+
+// Output clock, advanced by the DMA completion events
+static QueueHandle_t events = nullptr;
+static _lock_t clock_lock;
+static i2s::Position position = {};
+// Frames handed to the DMA buffers, in the same count as the position
+static std::atomic<uint64_t> written{0};
+// DMA buffers that went out without new data while we were streaming
+static std::atomic<bool> playing{false};
+// Frames buffered ahead of the output for get_latency_us, at the input rate
+static std::atomic<float> buffered{0};
+static std::atomic<uint32_t> dma_underruns{0};
+
+// Runs at a high priority so the timestamps are taken right after the DMA buffer completed
+static void track(void*) {
+	for (;;) {
+		i2s_event_t event;
+		if (xQueueReceive(events, &event, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+
+		int64_t now = esp_timer_get_time();
+		if (event.type == I2S_EVENT_TX_DONE) {
+			_lock_acquire(&clock_lock);
+			position.frames += DMA_FRAME_NUM;
+			position.time_us = now;
+			_lock_release(&clock_lock);
+		} else if (event.type == I2S_EVENT_TX_Q_OVF && playing.load(std::memory_order_relaxed)) {
+			dma_underruns.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+// Blocks go from the processing task to the output task and back through these queues
+struct Pending {
+	uint8_t index;
+	uint16_t frames;
+};
+static QueueHandle_t free_blocks = nullptr;
+static QueueHandle_t filled_blocks = nullptr;
+// Frames that are processed but not yet handed to the DMA buffers
+static std::atomic<uint32_t> pipelined{0};
 
-static RingbufHandle_t ringbuffer = nullptr;
+// Worst case per stage since the stats were last read, in cycles per block
+// Raised by the i2s and output tasks and reset by the reader with an exchange
+static struct {
+	std::atomic<uint32_t> resample;
+	std::atomic<uint32_t> mix;
+	std::atomic<uint32_t> dsp;
+	std::atomic<uint32_t> kernels;
+	std::atomic<uint32_t> total;
+	std::atomic<uint32_t> output;
+} timing;
+
+static void measure(std::atomic<uint32_t>& stage, uint32_t& start) {
+	uint32_t now = esp_cpu_get_cycle_count();
+	extremes::raise(stage, now - start);
+	start = now;
+}
+
+static void write_block(const uint32_t* data, size_t frames) {
+	// After being idle the DMA buffers only hold silence, the new frames are queued from the current position on
+	uint64_t start = std::max(written.load(std::memory_order_relaxed), i2s::get_position().frames);
+
+	size_t length = frames * I2S_FRAME_WORDS * sizeof(uint32_t);
+	size_t bytes_written = 0;
+	if (i2s_write(I2S_PORT, data, length, &bytes_written, portMAX_DELAY) != ESP_OK) {
+		ESP_LOGE(I2S_TAG, "i2s_write has failed");
+	}
+	written.store(start + bytes_written / (I2S_FRAME_WORDS * sizeof(uint32_t)), std::memory_order_relaxed);
+
+	if (bytes_written < length) {
+		ESP_LOGE(I2S_TAG, "Timeout: not all bytes were written to I2S");
+	}
+}
+
+#ifndef CONFIG_CAR_STEREO_FIXED_OUTPUT_RATE
+static void change_clock(uint32_t rate) {
+	// Push everything that is still in the DMA buffers out at the old rate
+	static const uint32_t silence[DMA_FRAMES * I2S_FRAME_WORDS] = {};
+	write_block(silence, DMA_FRAMES);
+
+	// Reclocking clears the DMA buffers
+	bool changed = i2s_set_clk(I2S_PORT, rate, I2S_BITS, I2S_CHANNEL_STEREO) == ESP_OK;
+	written.store(i2s::get_position().frames, std::memory_order_relaxed);
+	if (!changed) {
+		ESP_LOGE(I2S_TAG, "i2s_set_clk failed with samplerate=%d", rate);
+		return;
+	}
+
+	output_rate = rate;
+	ESP_LOGI(I2S_TAG, "samplerate=%d", rate);
+
+#ifdef CONFIG_CAR_STEREO_APLL
+	// The driver programmed the APLL for the nominal rate again
+	steering = apll::start(rate);
+#endif
+}
+#endif
+
+// Only waits on i2s, so it can run at a higher priority than the processing without taking time from it
+static void output(void*) {
+	for (;;) {
+		Pending pending;
+		if (xQueueReceive(filled_blocks, &pending, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+
+		uint32_t start = esp_cpu_get_cycle_count();
+#ifdef CONFIG_CAR_STEREO_I2S_32BIT
+		kernels::expand(blocks[pending.index], expanded, pending.frames);
+		write_block(expanded, pending.frames);
+#else
+		write_block(blocks[pending.index], pending.frames);
+#endif
+		extremes::raise(timing.output, esp_cpu_get_cycle_count() - start);
+
+		pipelined.fetch_sub(pending.frames, std::memory_order_relaxed);
+		xQueueSend(free_blocks, &pending.index, portMAX_DELAY);
+	}
+}
 
 static void task(void*) {
-	ESP_LOGI(I2S_TAG, "Starting i2s task");
+	ESP_LOGI(I2S_TAG, "Starting i2s task on core %d", xPortGetCoreID());
+	resampler.set_bandwidth(Resampler::bandwidth_for(nominal_ratio));
+
+	bool streaming = false;
+#ifndef CONFIG_CAR_STEREO_FIXED_OUTPUT_RATE
+	RateFade fade;
+#endif
+	uint8_t index = 0;
+	uint32_t* block = nullptr;
 	for (;;) {
-		size_t length = 0;
-		uint8_t* data = (uint8_t*)xRingbufferReceive(ringbuffer, &length, portMAX_DELAY);
-
-		// @TODO Swap channels
-		if (length) {
-			size_t bytes_written;
-			if (i2s_write(I2S_PORT, data, length, &bytes_written, portMAX_DELAY) != ESP_OK) {
-				ESP_LOGE(I2S_TAG, "i2s_write has failed");
+		// Waits here while both blocks are in flight
+		if (!block) {
+			xQueueReceive(free_blocks, &index, portMAX_DELAY);
+			block = blocks[index];
+		}
+
+		// Frames left at the current rate, only limited if there is a pending sample rate change
+		// Only switch once the last frame at the old rate has been played
+		size_t remaining = rate_changes.remaining(ringbuffer.read_position());
+		if (!remaining) {
+			uint32_t rate = rate_changes.take(ringbuffer.read_position());
+#ifdef CONFIG_CAR_STEREO_FIXED_OUTPUT_RATE
+			// i2s keeps running at the same rate, so only the conversion changes and there is no need to fade
+			nominal_ratio = (float)rate / output_rate;
+			resampler.set_bandwidth(Resampler::bandwidth_for(nominal_ratio));
+			ESP_LOGI(I2S_TAG, "samplerate=%d, resampling to %d", rate, output_rate);
+#else
+			// The other block still has to go out at the old rate
+			uint8_t other;
+			xQueueReceive(free_blocks, &other, portMAX_DELAY);
+			change_clock(rate);
+			xQueueSend(free_blocks, &other, portMAX_DELAY);
+
+			// The history of the resampler belongs to the old rate
+			resampler.reset();
+			fade.restart();
+#endif
+			// The target moves with the ratio, the integral would steer against the jump of the fill
+			drift.reset();
+			continue;
+		}
+
+		// The drift controller looks at everything that is buffered ahead of the output, including the block that is being written and the DMA buffers
+		// Lowering the target is slow, the drift controller only plays faster by a fraction of a percent
+		size_t buffer_target = target.load(std::memory_order_relaxed);
+		drift.set_target(buffer_target + (DMA_FRAMES + I2S_BLOCK_FRAMES) * nominal_ratio);
+		playing.store(streaming, std::memory_order_relaxed);
+		if (!streaming) {
+			// The buffer is going to be filled up to the target before the stream starts
+			buffered.store(drift.get_target(), std::memory_order_relaxed);
+		}
+
+		if (!streaming) {
+			// Fill the buffer up to the target depth first, so the drift controller starts close to its setpoint
+			// Prompts keep playing over silence in the meantime
+			size_t available = ringbuffer.available();
+			if (available >= buffer_target) {
+				streaming = true;
+			} else if (!mixer::active()) {
+				bool received = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PREBUFFER_TIMEOUT_MS));
+				if (received || !available) {
+					continue;
+				}
+
+				streaming = true;
 			}
+		}
+
+		uint32_t start = esp_cpu_get_cycle_count();
+		uint32_t begin = start;
 
-			if (bytes_written < length) {
-				ESP_LOGE(I2S_TAG, "Timeout: not all bytes were written to I2S");
+		size_t frames = 0;
+		if (streaming) {
+			// The resampler reads straight from the buffer and corrects for the clock difference between the phone and us
+			size_t depth = ringbuffer.available() + i2s::get_queued_frames() * nominal_ratio;
+			float ratio = drift.update(depth);
+			// The smoothed fill, the raw one jumps around with every packet
+			buffered.store(drift.get_fill(), std::memory_order_relaxed);
+			if (steering) {
+				apll::trim(ratio);
+				ratio = 1.f;
 			}
+			resampler.set_ratio(nominal_ratio * ratio);
+			frames = resampler.process(ringbuffer, block, I2S_BLOCK_FRAMES, remaining);
+
+			// We ran dry while we were playing, hitting a sample rate change is not an underrun
+			bool at_change = !rate_changes.remaining(ringbuffer.read_position());
+			if (frames < I2S_BLOCK_FRAMES && !at_change) {
+				ringbuffer.underrun();
+				streaming = false;
+				// The next stream starts at the target again, steering with the state of the old one would push it off right away
+				drift.reset();
+			}
+
+#ifndef CONFIG_CAR_STEREO_FIXED_OUTPUT_RATE
+			fade.apply(block, frames, remaining, resampler.get_ratio());
+#endif
+		}
+		measure(timing.resample, start);
+
+		if (mixer::active()) {
+			// Pad the music with silence so prompts play for the entire block
+			std::fill(block + frames, block + I2S_BLOCK_FRAMES, 0);
+			frames = I2S_BLOCK_FRAMES;
+
+			mixer::process(block, frames, output_rate);
+		}
+		measure(timing.mix, start);
 
-			vRingbufferReturnItem(ringbuffer, data);
+		if (!frames) {
+			continue;
 		}
+
+		audio::process(block, frames, output_rate);
+		measure(timing.dsp, start);
+
+		kernels::apply(channels.load(std::memory_order_relaxed), inverted.load(std::memory_order_relaxed), block, frames);
+		measure(timing.kernels, start);
+		extremes::raise(timing.total, start - begin);
+
+		pipelined.fetch_add(frames, std::memory_order_relaxed);
+		Pending pending = {index, (uint16_t)frames};
+		xQueueSend(filled_blocks, &pending, portMAX_DELAY);
+		block = nullptr;
 	}
 }
 
@@ -43,21 +386,21 @@ void i2s::init() {
 
 	i2s_config_t i2s_config = {
 		.mode = (i2s_mode_t) (I2S_MODE_MASTER | I2S_MODE_TX),
-		.sample_rate = get_sample_rate(),
-		.bits_per_sample = (i2s_bits_per_sample_t)16,
+		.sample_rate = output_rate,
+		.bits_per_sample = (i2s_bits_per_sample_t)I2S_BITS,
 		.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,
 		.communication_format = (i2s_comm_format_t) (I2S_COMM_FORMAT_STAND_I2S),
 		.intr_alloc_flags = 0, // default interrupt priority
-		.dma_desc_num = 8,
-		.dma_frame_num = 64,
-		.use_apll = false,
+		.dma_desc_num = DMA_DESC_NUM,
+		.dma_frame_num = DMA_FRAME_NUM,
+		.use_apll = USE_APLL,
 		.tx_desc_auto_clear = true, // avoiding noise in case of data unavailability
 		.fixed_mclk = 0,
 		.mclk_multiple = I2S_MCLK_MULTIPLE_DEFAULT,
 		.bits_per_chan = I2S_BITS_PER_CHAN_DEFAULT,
 	};
 
-	if (i2s_driver_install(i2s_port, &i2s_config, 0, nullptr) != ESP_OK) {
+	if (i2s_driver_install(i2s_port, &i2s_config, EVENT_QUEUE_LENGTH, &events) != ESP_OK) {
 		ESP_LOGE(I2S_TAG, "i2s_driver_install failed");
 	}
 
@@ -73,41 +416,137 @@ void i2s::init() {
 		ESP_LOGE(I2S_TAG, "i2s_set_pin failed");
 	}
 
-	ringbuffer = xRingbufferCreate(RINGBUF_SIZE, RINGBUF_TYPE_BYTEBUF);
-	if (!ringbuffer) {
-		ESP_LOGE(I2S_TAG, "Failed to create ringbuffer");
-		return;
+#ifdef CONFIG_CAR_STEREO_APLL
+	steering = apll::start(output_rate);
+#endif
+
+	free_blocks = xQueueCreate(PIPELINE_BLOCKS, sizeof(uint8_t));
+	filled_blocks = xQueueCreate(PIPELINE_BLOCKS, sizeof(Pending));
+	for (uint8_t i = 0; i < PIPELINE_BLOCKS; i++) {
+		xQueueSend(free_blocks, &i, 0);
 	}
 
-	xTaskCreate(task, "I2S Task", 2048, nullptr, 0, nullptr);
+	if (xTaskCreate(track, "I2S Clock", 2048, nullptr, configMAX_PRIORITIES - 2, nullptr) != pdPASS) {
+		ESP_LOGE(I2S_TAG, "Failed to create i2s clock task");
+	}
+
+	// Bluedroid runs on the other core, so the processing can never starve it
+	if (xTaskCreatePinnedToCore(output, "I2S Output", OUTPUT_STACK, nullptr, CONFIG_CAR_STEREO_AUDIO_PRIORITY + 1, &output_handle, CONFIG_CAR_STEREO_AUDIO_CORE) != pdPASS) {
+		ESP_LOGE(I2S_TAG, "Failed to create i2s output task");
+	}
+
+	if (xTaskCreatePinnedToCore(task, "I2S Task", CONFIG_CAR_STEREO_AUDIO_STACK, nullptr, CONFIG_CAR_STEREO_AUDIO_PRIORITY, &task_handle, CONFIG_CAR_STEREO_AUDIO_CORE) != pdPASS) {
+		ESP_LOGE(I2S_TAG, "Failed to create i2s task");
+	}
 }
 
-static uint32_t sample_rate = 44100;
+// Called from the bluetooth stack, everything that is already buffered still has to play at the old rate
+// So we only tag the position in the stream and let the i2s task change the clock once it gets there
 void i2s::set_sample_rate(uint32_t sp) {
+	if (sp == sample_rate) {
+		return;
+	}
 	sample_rate = sp;
 
-	if (i2s_set_clk(I2S_PORT, sample_rate, 16, I2S_CHANNEL_STEREO) != ESP_OK){
-		ESP_LOGE(I2S_TAG, "i2s_set_clk failed with samplerate=%d", sample_rate);
-	} else {
-		ESP_LOGI(I2S_TAG, "samplerate=%d", sample_rate);
+	if (!rate_changes.push(ringbuffer.write_position(), sample_rate)) {
+		ESP_LOGE(I2S_TAG, "Too many pending sample rate changes");
 	}
+
+	xTaskNotifyGive(task_handle);
 }
 
 uint32_t i2s::get_sample_rate() {
 	return sample_rate;
 }
 
+uint32_t i2s::get_output_rate() {
+	return output_rate;
+}
+
+i2s::Position i2s::get_position() {
+	_lock_acquire(&clock_lock);
+	Position p = position;
+	_lock_release(&clock_lock);
+
+	// Interpolate into the DMA buffer that is going out right now
+	int64_t now = esp_timer_get_time();
+	p.frames += std::min<int64_t>((now - p.time_us) * output_rate / 1000000, DMA_FRAME_NUM);
+	p.time_us = now;
+	return p;
+}
+
+uint32_t i2s::get_queued_frames() {
+	uint64_t played = get_position().frames;
+	uint64_t queued = written.load(std::memory_order_relaxed);
+	uint32_t dma = queued > played ? std::min<uint64_t>(queued - played, DMA_FRAMES) : 0;
+	return dma + pipelined.load(std::memory_order_relaxed);
+}
+
+// The worst case is reset every time, so every call covers the time since the previous one
+i2s::Timing i2s::get_timing() {
+	return {
+		.resample = timing.resample.exchange(0, std::memory_order_relaxed),
+		.mix = timing.mix.exchange(0, std::memory_order_relaxed),
+		.dsp = timing.dsp.exchange(0, std::memory_order_relaxed),
+		.kernels = timing.kernels.exchange(0, std::memory_order_relaxed),
+		.total = timing.total.exchange(0, std::memory_order_relaxed),
+		.output = timing.output.exchange(0, std::memory_order_relaxed),
+		.frames = I2S_BLOCK_FRAMES,
+		.budget = (uint32_t)((uint64_t)I2S_BLOCK_FRAMES * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000000 / output_rate),
+	};
+}
+
+// Includes the DMA buffers, published by the i2s task once per block
+uint32_t i2s::get_latency_us() {
+	uint64_t fill = buffered.load(std::memory_order_relaxed);
+	return fill * 1000000 / sample_rate + audio::get_latency_us();
+}
+
+// The new target is used from the next packet on
+void i2s::set_latency(Latency l) {
+	latency.store(l, std::memory_order_relaxed);
+	ESP_LOGI(I2S_TAG, "Latency mode: %s", JitterEstimator::get_name(l));
+}
+
+Latency i2s::get_latency() {
+	return latency.load(std::memory_order_relaxed);
+}
+
+// Takes effect from the next block on
+void i2s::set_channels(kernels::Channels mode, bool invert) {
+	channels.store(mode, std::memory_order_relaxed);
+	inverted.store(invert, std::memory_order_relaxed);
+}
+
+// Called from the bluetooth stack, so this should never block
 void i2s::write(const uint8_t* data, size_t length) {
-	UBaseType_t items;
-	vRingbufferGetInfo(ringbuffer, nullptr, nullptr, nullptr, nullptr, &items);
+	size_t frames = length / AUDIO_SAMPLE_SIZE;
 
-	if (items < RINGBUF_SIZE * 3/8) {
-		xRingbufferSend(ringbuffer, data, AUDIO_SAMPLE_SIZE, portMAX_DELAY);
-	} else if (items > RINGBUF_SIZE * 5/8) {
-		length -= AUDIO_SAMPLE_SIZE;
-	}
+	Latency l = latency.load(std::memory_order_relaxed);
+	jitter.arrive(esp_timer_get_time(), frames, sample_rate);
+	target.store(jitter.get_target(l), std::memory_order_relaxed);
+	measured_jitter.store(jitter.get_jitter(l), std::memory_order_relaxed);
 
-	if (!xRingbufferSend(ringbuffer, data, length, portMAX_DELAY)) {
+	if (ringbuffer.write(data, frames) < frames) {
 		ESP_LOGE(I2S_TAG, "Failed to write to ringbuffer");
 	}
+
+	xTaskNotifyGive(task_handle);
+}
+
+i2s::Stats i2s::get_stats() {
+	return {
+		.buffer = ringbuffer.get_stats(),
+		.fill = ringbuffer.available(),
+		.capacity = ringbuffer.capacity(),
+		.target = target.load(std::memory_order_relaxed),
+		.jitter = measured_jitter.load(std::memory_order_relaxed),
+		.latency = latency.load(std::memory_order_relaxed),
+		.drift_ppm = (int32_t)((drift.get_ratio() - 1) * 1e6f),
+		.apll_ppm = apll::get_ppm(),
+		.latency_us = get_latency_us(),
+		.dma_underruns = dma_underruns.load(std::memory_order_relaxed),
+		.task_stack_free = task_handle ? uxTaskGetStackHighWaterMark(task_handle) : 0,
+		.output_stack_free = output_handle ? uxTaskGetStackHighWaterMark(output_handle) : 0,
+	};
 }
@@ -0,0 +1,72 @@
+#include <algorithm>
+
+#include "jitter.h"
+
+struct Mode {
+	const char* name;
+	// Windows of history the worst case is taken from
+	size_t history;
+	// Multiplier on the measured spread, in percent
+	size_t factor;
+	// Added on top, raised to a single i2s block when that is larger
+	size_t margin;
+	size_t min;
+	size_t max;
+};
+
+// The buffer holds 4096 frames, the targets stay below 3/4 of it so a burst still fits
+static constexpr Mode modes[(size_t)Latency::COUNT] = {
+	{"low latency", 2, 100, 0, 512, 2048},
+	{"normal", 8, 150, 512, 1024, 3072},
+	{"robust", 30, 200, 1024, 2048, 3072},
+};
+
+static_assert(modes[(size_t)Latency::ROBUST].history <= JITTER_HISTORY - 1, "The history does not fit");
+
+void JitterEstimator::arrive(int64_t time_us, size_t frames, uint32_t sample_rate) {
+	if (sample_rate != rate || time_us - last_arrival > JITTER_GAP_US) {
+		rate = sample_rate;
+		origin = time_us;
+		received = 0;
+		window_start = time_us;
+		earliest = 0;
+		latest = 0;
+	}
+	last_arrival = time_us;
+
+	// How late this packet is compared to a clock running at the sample rate
+	int64_t transit = (time_us - origin) * sample_rate / 1000000 - received;
+	received += frames;
+
+	if (time_us - window_start >= JITTER_WINDOW_US) {
+		current = (current + 1) % JITTER_HISTORY;
+		spreads[current] = 0;
+		window_start = time_us;
+		earliest = transit;
+		latest = transit;
+	}
+
+	earliest = std::min(earliest, transit);
+	latest = std::max(latest, transit);
+	spreads[current] = latest - earliest;
+}
+
+size_t JitterEstimator::get_jitter(Latency latency) const {
+	const Mode& mode = modes[(size_t)latency];
+
+	// Includes the window that is still running
+	uint32_t worst = 0;
+	for (size_t i = 0; i <= mode.history; i++) {
+		worst = std::max(worst, spreads[(current + JITTER_HISTORY - i) % JITTER_HISTORY]);
+	}
+	return worst;
+}
+
+size_t JitterEstimator::get_target(Latency latency) const {
+	const Mode& mode = modes[(size_t)latency];
+	return std::clamp(get_jitter(latency) * mode.factor / 100 + std::max(mode.margin, block_frames), mode.min, mode.max);
+}
+
+const char* JitterEstimator::get_name(Latency latency) {
+	return modes[(size_t)latency].name;
+}
@@ -0,0 +1,34 @@
+#include <algorithm>
+
+#include "loudness.h"
+
+static constexpr uint32_t rates[] = {16000, 32000, 44100, 48000};
+static constexpr size_t RATE_COUNT = sizeof(rates) / sizeof(rates[0]);
+
+using Banks = std::array<std::array<eq::Bank<LOUDNESS_BANDS>, LOUDNESS_STEPS>, RATE_COUNT>;
+
+static constexpr Banks design_banks() {
+	Banks banks = {};
+	for (size_t rate = 0; rate < RATE_COUNT; rate++) {
+		for (uint8_t step = 0; step < LOUDNESS_STEPS; step++) {
+			banks[rate][step] = loudness::design(step, rates[rate]);
+		}
+	}
+	return banks;
+}
+
+// Designed by the compiler, so following the volume does not need any trigonometry
+static constexpr Banks banks = design_banks();
+
+eq::Bank<LOUDNESS_BANDS> loudness::get_bank(uint8_t step, uint32_t sample_rate) {
+	step = std::min<uint8_t>(step, LOUDNESS_STEPS - 1);
+
+	for (size_t rate = 0; rate < RATE_COUNT; rate++) {
+		if (rates[rate] == sample_rate) {
+			return banks[rate][step];
+		}
+	}
+
+	// Only happens with an unusual fixed output rate
+	return design(step, sample_rate);
+}
@@ -11,6 +11,10 @@
 #include "twai.h"
 #include "volume.h"
 #include "leds.h"
+#include "wav.h"
+#include "audio.h"
+#include "stats.h"
+#include "benchmark.h"
 
 #define APP_TAG "APP"
 
@@ -18,10 +22,16 @@ extern "C" void app_main() {
 	ESP_LOGI(APP_TAG, "Starting Car Stereo");
 	ESP_LOGI(APP_TAG, "Available Heap: %u", esp_get_free_heap_size());
 
+#ifdef CONFIG_CAR_STEREO_BENCHMARK
+	benchmark::run();
+#endif
+
 	leds::init();
 
 	nvs::init();
+	audio::init();
 	i2s::init();
+	wav::init();
 	bluetooth::init();
 
 	avrcp::init();
@@ -31,4 +41,6 @@ extern "C" void app_main() {
 
 	twai::init();
 	volume_controller::init();
+
+	stats::init();
 }
@@ -0,0 +1,84 @@
+#include <cmath>
+#include <cstdint>
+#include <atomic>
+#include <algorithm>
+
+#include "sys/lock.h"
+#include "esp_timer.h"
+
+#include "meter.h"
+
+struct Window {
+	double sum;
+	double squares;
+	float peak;
+	uint32_t clips;
+};
+
+static _lock_t lock;
+static Window left = {};
+static Window right = {};
+static uint32_t frames = 0;
+
+// Nothing above the silence level was played since boot
+#define NEVER INT64_MIN
+
+static std::atomic<int64_t> last_sound{NEVER};
+
+static void add(Window& window, const meter::Accumulator& block) {
+	window.sum += block.sum;
+	window.squares += block.squares;
+	window.peak = std::max(window.peak, (float)block.peak);
+	window.clips += block.clips;
+}
+
+static float to_db(float value) {
+	return 20.f * log10f(std::max(value / 32768.f, 1e-5f));
+}
+
+static meter::Level level(Window& window, uint32_t length) {
+	meter::Level l = {
+		.rms_db = to_db(length ? sqrt(window.squares / length) : 0),
+		.peak_db = to_db(window.peak),
+		.dc = length ? (float)(window.sum / length / 32768) : 0,
+		.clips = window.clips,
+	};
+
+	// The clip counter keeps running
+	window = {.sum = 0, .squares = 0, .peak = 0, .clips = window.clips};
+	return l;
+}
+
+void meter::publish(const Meter& meter, size_t length) {
+	_lock_acquire(&lock);
+	add(left, meter.get_left());
+	add(right, meter.get_right());
+	frames += length;
+	_lock_release(&lock);
+
+	if (std::max(meter.get_left().peak, meter.get_right().peak) > METER_SILENCE_LEVEL) {
+		last_sound.store(esp_timer_get_time(), std::memory_order_relaxed);
+	}
+}
+
+meter::Snapshot meter::get_snapshot() {
+	Snapshot snapshot = {};
+
+	_lock_acquire(&lock);
+	snapshot.left = level(left, frames);
+	snapshot.right = level(right, frames);
+	snapshot.frames = frames;
+	frames = 0;
+	_lock_release(&lock);
+
+	int64_t last = last_sound.load(std::memory_order_relaxed);
+	int64_t now = esp_timer_get_time();
+	snapshot.silent_ms = (now - (last == NEVER ? 0 : last)) / 1000;
+	snapshot.silent = silent();
+	return snapshot;
+}
+
+bool meter::silent() {
+	int64_t last = last_sound.load(std::memory_order_relaxed);
+	return last == NEVER || esp_timer_get_time() - last > (int64_t)CONFIG_CAR_STEREO_SILENCE_TIMEOUT * 1000;
+}
@@ -0,0 +1,183 @@
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+
+#include "esp_log.h"
+
+#include "mixer.h"
+#include "ring_buffer.h"
+#include "resampler.h"
+
+#define MIXER_TAG "APP_MIXER"
+
+// Frames buffered per voice, has to cover at least one scheduler tick of the task writing to it and two blocks
+#define VOICE_FRAMES (CONFIG_CAR_STEREO_BLOCK_FRAMES > 512 ? 2048 : 1024)
+// Largest block process gets called with
+#define MIXER_BLOCK_FRAMES CONFIG_CAR_STEREO_BLOCK_FRAMES
+// Time it takes the music to duck and come back up
+#define DUCK_RAMP_MS 50
+
+enum class State : uint8_t {
+	FREE,
+	// Being set up by acquire
+	CLAIMED,
+	// The writer is still adding frames
+	PLAYING,
+	// The writer is done, play what is left
+	DRAINING,
+	// Interrupted, fade out and drop what is left
+	STOPPING,
+};
+
+struct mixer::Voice {
+	std::atomic<State> state{State::FREE};
+	uint32_t sample_rate = 0;
+
+	uint32_t storage[VOICE_FRAMES];
+	RingBuffer input{storage, VOICE_FRAMES};
+	Resampler resampler;
+};
+
+static mixer::Voice voices[CONFIG_CAR_STEREO_MIXER_VOICES];
+
+// Gain of the music, ramps towards the ducked level while prompts are playing
+static float music_gain = 1.f;
+static const float ducked_gain = powf(10.f, CONFIG_CAR_STEREO_DUCKING / 20.f);
+
+mixer::Voice* mixer::acquire(uint32_t sample_rate) {
+	for (Voice& voice : voices) {
+		State expected = State::FREE;
+		if (!voice.state.compare_exchange_strong(expected, State::CLAIMED, std::memory_order_acquire)) {
+			continue;
+		}
+
+		// The mixer ignores claimed voices, so we can set everything up before publishing it
+		voice.sample_rate = sample_rate;
+		voice.resampler.reset();
+		voice.state.store(State::PLAYING, std::memory_order_release);
+
+		return &voice;
+	}
+
+	ESP_LOGW(MIXER_TAG, "All voices are in use");
+	return nullptr;
+}
+
+RingBuffer::Region mixer::reserve(Voice* voice, size_t length) {
+	return voice->input.reserve(std::min(length, voice->input.space()));
+}
+
+void mixer::commit(Voice* voice, size_t length) {
+	voice->input.commit(length);
+}
+
+void mixer::release(Voice* voice) {
+	voice->state.store(State::DRAINING, std::memory_order_release);
+}
+
+void mixer::stop(Voice* voice) {
+	voice->state.store(State::STOPPING, std::memory_order_release);
+}
+
+static bool audible(State state) {
+	return state == State::PLAYING || state == State::DRAINING || state == State::STOPPING;
+}
+
+static bool playing() {
+	for (const mixer::Voice& voice : voices) {
+		if (audible(voice.state.load(std::memory_order_acquire))) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool mixer::active() {
+	return playing() || music_gain < 1.f;
+}
+
+static inline int16_t saturate(int32_t sample) {
+	return std::clamp<int32_t>(sample, -32768, 32767);
+}
+
+// Adds the voice to the frames with saturation, both channels at once
+static void add(uint32_t* frames, const uint32_t* voice, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		int16_t first = saturate((int32_t)(int16_t)frames[i] + (int16_t)voice[i]);
+		int16_t second = saturate((int32_t)(int16_t)(frames[i] >> 16) + (int16_t)(voice[i] >> 16));
+		frames[i] = (uint16_t)first | ((uint32_t)(uint16_t)second << 16);
+	}
+}
+
+// Linear fade to silence over the entire block
+static void fade_out(uint32_t* frames, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		float gain = (float)(length - i) / length;
+
+		int16_t first = (int16_t)frames[i] * gain;
+		int16_t second = (int16_t)(frames[i] >> 16) * gain;
+		frames[i] = (uint16_t)first | ((uint32_t)(uint16_t)second << 16);
+	}
+}
+
+static void duck(uint32_t* frames, size_t length, uint32_t sample_rate, bool ducking) {
+	if (!ducking && music_gain == 1.f) {
+		return;
+	}
+
+	float target = ducking ? ducked_gain : 1.f;
+
+	// Linear ramp, the step is the full range over DUCK_RAMP_MS
+	float step = (1.f - ducked_gain) * 1000.f / (DUCK_RAMP_MS * sample_rate);
+	for (size_t i = 0; i < length; i++) {
+		if (music_gain > target) {
+			music_gain = std::max(music_gain - step, target);
+		} else if (music_gain < target) {
+			music_gain = std::min(music_gain + step, target);
+		}
+
+		int16_t first = (int16_t)frames[i] * music_gain;
+		int16_t second = (int16_t)(frames[i] >> 16) * music_gain;
+		frames[i] = (uint16_t)first | ((uint32_t)(uint16_t)second << 16);
+	}
+}
+
+void mixer::process(uint32_t* frames, size_t length, uint32_t sample_rate) {
+	duck(frames, length, sample_rate, playing());
+
+	static uint32_t block[MIXER_BLOCK_FRAMES];
+	if (length > MIXER_BLOCK_FRAMES) {
+		ESP_LOGE(MIXER_TAG, "Block of %u frames is larger than %u", (unsigned)length, (unsigned)MIXER_BLOCK_FRAMES);
+		length = MIXER_BLOCK_FRAMES;
+	}
+
+	for (Voice& voice : voices) {
+		State state = voice.state.load(std::memory_order_acquire);
+		if (!audible(state)) {
+			continue;
+		}
+
+		// Follow the rate of the stream, so i2s never has to be reclocked for a prompt
+		float ratio = (float)voice.sample_rate / sample_rate;
+		if (voice.resampler.get_ratio() != ratio) {
+			voice.resampler.set_ratio(ratio);
+			voice.resampler.set_bandwidth(Resampler::bandwidth_for(ratio));
+		}
+
+		size_t produced = voice.resampler.process(voice.input, block, length);
+
+		if (state == State::STOPPING) {
+			fade_out(block, produced);
+
+			// Drop whatever was still queued
+			voice.input.release(voice.input.available());
+			voice.state.store(State::FREE, std::memory_order_release);
+		} else if (state == State::DRAINING && produced < length) {
+			// Everything has been played
+			voice.state.store(State::FREE, std::memory_order_release);
+		}
+
+		add(frames, block, produced);
+	}
+}
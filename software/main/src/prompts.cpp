@@ -0,0 +1,110 @@
+#include <cstring>
+#include <algorithm>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#include "prompts.h"
+#include "assets.h"
+
+#define PROMPTS_TAG "APP_PROMPTS"
+#define PROMPTS_PARTITION "prompts"
+
+// Contents of the mapped partition, without the RIFF header
+static const uint8_t* partition = nullptr;
+static size_t partition_size = 0;
+
+// Names are padded with zeros
+static bool match_name(const riff::Chunk& chunk, const char* name) {
+	size_t length = strlen(name);
+	return strnlen((const char*)chunk.data, chunk.size) == length && !memcmp(chunk.data, name, length);
+}
+
+// Calls the callback with the name chunk and the parsed wave of every prompt in the partition
+template <typename F>
+static bool walk(F callback) {
+	riff::Reader reader(partition, partition_size);
+	riff::Chunk chunk;
+	riff::Chunk name = {};
+	while (reader.next(chunk)) {
+		if (riff::match(chunk.id, "name")) {
+			name = chunk;
+		} else if (name.id && riff::match(chunk.id, "RIFF")) {
+			if (callback(name, riff::parse(chunk.id, chunk.size + 8))) {
+				return true;
+			}
+			name = {};
+		}
+	}
+
+	return false;
+}
+
+void prompts::init() {
+	const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, PROMPTS_PARTITION);
+	if (!part) {
+		ESP_LOGI(PROMPTS_TAG, "No prompts partition, using the embedded prompts");
+		return;
+	}
+
+	const void* data;
+	spi_flash_mmap_handle_t handle;
+	esp_err_t err = esp_partition_mmap(part, 0, part->size, SPI_FLASH_MMAP_DATA, &data, &handle);
+	if (err != ESP_OK) {
+		ESP_LOGE(PROMPTS_TAG, "Failed to map prompts partition: %s", esp_err_to_name(err));
+		return;
+	}
+
+	// An erased partition does not contain a RIFF file
+	const uint8_t* riff = (const uint8_t*)data;
+	if (part->size < 12 || !riff::match(riff, "RIFF") || !riff::match(riff + 8, "PRMT")) {
+		ESP_LOGI(PROMPTS_TAG, "Prompts partition is empty, using the embedded prompts");
+		spi_flash_munmap(handle);
+		return;
+	}
+
+	// The size includes the form type, anything smaller is a corrupt header
+	size_t size = riff::read_u32(riff + 4);
+	if (size < 4) {
+		ESP_LOGE(PROMPTS_TAG, "Prompts partition has an invalid size, using the embedded prompts");
+		spi_flash_munmap(handle);
+		return;
+	}
+
+	partition = riff + 12;
+	partition_size = std::min<size_t>(size, part->size - 8) - 4;
+
+	walk([](const riff::Chunk& name, const riff::Wave& wave) {
+		if (wave.valid()) {
+			ESP_LOGI(PROMPTS_TAG, "Found prompt '%.*s': %u Hz, %u channels", (int)name.size, (const char*)name.data, wave.format.sample_rate, wave.format.channels);
+		} else {
+			ESP_LOGE(PROMPTS_TAG, "Invalid prompt '%.*s': %s", (int)name.size, (const char*)name.data, wave.error);
+		}
+		return false;
+	});
+}
+
+riff::Wave prompts::find(const char* name) {
+	riff::Wave found;
+	walk([&](const riff::Chunk& chunk, const riff::Wave& wave) {
+		if (!match_name(chunk, name) || !wave.valid()) {
+			return false;
+		}
+
+		found = wave;
+		return true;
+	});
+
+	if (found.valid()) {
+		return found;
+	}
+
+	for (const assets::Asset& asset : assets::table) {
+		if (!strcmp(asset.name, name)) {
+			return asset.wave;
+		}
+	}
+
+	ESP_LOGE(PROMPTS_TAG, "Unknown prompt '%s'", name);
+	return riff::invalid("Unknown prompt");
+}
@@ -0,0 +1,56 @@
+#include "rate_changes.h"
+
+bool RateChanges::push(uint32_t position, uint32_t rate) {
+	uint32_t change[2] = {position, rate};
+	return buffer.write(change, 2) == 2;
+}
+
+size_t RateChanges::remaining(uint32_t read_position) const {
+	const uint32_t* change = nullptr;
+	if (!buffer.peek(&change)) {
+		return SIZE_MAX;
+	}
+
+	// Positions wrap around, the difference does not
+	return change[0] - read_position;
+}
+
+uint32_t RateChanges::take(uint32_t read_position) {
+	if (remaining(read_position)) {
+		return 0;
+	}
+
+	const uint32_t* change = nullptr;
+	buffer.peek(&change);
+	uint32_t rate = change[1];
+	buffer.release(2);
+	return rate;
+}
+
+// Scales the frames by (offset + index * step) / RATE_FADE_FRAMES, clamped between 0 and 1
+static void fade(uint32_t* frames, size_t length, float offset, float step) {
+	for (size_t i = 0; i < length; i++) {
+		float gain = (offset + i * step) / RATE_FADE_FRAMES;
+		if (gain >= 1.f) {
+			continue;
+		}
+		if (gain < 0.f) {
+			gain = 0.f;
+		}
+
+		int16_t first = (int16_t)frames[i] * gain;
+		int16_t second = (int16_t)(frames[i] >> 16) * gain;
+		frames[i] = (uint16_t)first | ((uint32_t)(uint16_t)second << 16);
+	}
+}
+
+void RateFade::apply(uint32_t* frames, size_t length, size_t remaining, float ratio) {
+	if (remaining < RATE_FADE_FRAMES + length * ratio) {
+		fade(frames, length, remaining, -ratio);
+	}
+
+	if (fade_in < RATE_FADE_FRAMES) {
+		fade(frames, length, fade_in, 1.f);
+		fade_in += length;
+	}
+}
@@ -0,0 +1,195 @@
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+
+#include "resampler.h"
+
+// The output frame is located between window[CENTER - 1] and window[CENTER]
+#define CENTER (RESAMPLER_TAPS / 2)
+// Leaves room for the transition band of the sinc filter
+#define TRANSITION_BAND 0.9f
+
+static inline int16_t saturate(float sample) {
+	return std::clamp(lrintf(sample), -32768l, 32767l);
+}
+
+static inline int16_t channel(uint32_t frame, int shift) {
+	return (int16_t)(frame >> shift);
+}
+
+static inline float cubic(float mu, int16_t x0, int16_t x1, int16_t x2, int16_t x3) {
+	// Catmull-Rom spline in Farrow form, the coefficients only depend on the input
+	float c1 = 0.5f * (x2 - x0);
+	float c2 = x0 - 2.5f * x1 + 2.f * x2 - 0.5f * x3;
+	float c3 = 0.5f * (x3 - x0) + 1.5f * (x1 - x2);
+
+	return ((c3 * mu + c2) * mu + c1) * mu + x1;
+}
+
+Resampler::Resampler(Quality quality) : quality(quality) {
+	set_bandwidth(1.f);
+}
+
+float Resampler::bandwidth_for(float ratio) {
+	// When downsampling the cutoff has to be below the Nyquist frequency of the output
+	return TRANSITION_BAND * std::min(1.f, 1.f / ratio);
+}
+
+void Resampler::set_bandwidth(float bandwidth) {
+	for (int phase = 0; phase <= RESAMPLER_PHASES; phase++) {
+		float mu = (float)phase / RESAMPLER_PHASES;
+		float* taps = &coefficients[phase * RESAMPLER_TAPS];
+
+		float sum = 0;
+		for (int tap = 0; tap < RESAMPLER_TAPS; tap++) {
+			// Distance between this tap and the output frame
+			float x = (tap - (CENTER - 1)) - mu;
+
+			float sinc = x == 0.f ? 1.f : sinf((float)M_PI * bandwidth * x) / ((float)M_PI * bandwidth * x);
+
+			// Blackman window spanning the entire history
+			float n = (x + CENTER) / (2 * CENTER);
+			float window = 0.42f - 0.5f * cosf(2 * (float)M_PI * n) + 0.08f * cosf(4 * (float)M_PI * n);
+
+			taps[tap] = sinc * window;
+			sum += taps[tap];
+		}
+
+		// Normalize for unity gain at DC
+		for (int tap = 0; tap < RESAMPLER_TAPS; tap++) {
+			taps[tap] /= sum;
+		}
+	}
+}
+
+void Resampler::set_quality(Quality q) {
+	quality = q;
+}
+
+void Resampler::push(uint32_t frame) {
+	history[index] = frame;
+	history[index + RESAMPLER_TAPS] = frame;
+	index = (index + 1) % RESAMPLER_TAPS;
+}
+
+template <Resampler::Quality Q>
+uint32_t Resampler::interpolate() const {
+	// Oldest frame first
+	const uint32_t* window = &history[index];
+
+	uint32_t frame = 0;
+	for (int shift = 0; shift < 32; shift += 16) {
+		float sample;
+		if constexpr (Q == Quality::LINEAR) {
+			float x0 = channel(window[CENTER - 1], shift);
+			float x1 = channel(window[CENTER], shift);
+			sample = x0 + (x1 - x0) * position;
+		} else if constexpr (Q == Quality::CUBIC) {
+			sample = cubic(position,
+					channel(window[CENTER - 2], shift),
+					channel(window[CENTER - 1], shift),
+					channel(window[CENTER], shift),
+					channel(window[CENTER + 1], shift));
+		} else {
+			// Linearly interpolate between the two closest precomputed phases
+			float phase = position * RESAMPLER_PHASES;
+			int p = std::min((int)phase, RESAMPLER_PHASES - 1);
+			float fraction = phase - p;
+			const float* a = &coefficients[p * RESAMPLER_TAPS];
+			const float* b = a + RESAMPLER_TAPS;
+
+			float sum_a = 0;
+			float sum_b = 0;
+			for (int tap = 0; tap < RESAMPLER_TAPS; tap++) {
+				float x = channel(window[tap], shift);
+				sum_a += a[tap] * x;
+				sum_b += b[tap] * x;
+			}
+			sample = sum_a + (sum_b - sum_a) * fraction;
+		}
+
+		frame |= (uint32_t)(uint16_t)saturate(sample) << shift;
+	}
+
+	return frame;
+}
+
+template <Resampler::Quality Q>
+size_t Resampler::run(RingBuffer& input, uint32_t* output, size_t frames, size_t limit) {
+	const uint32_t* data = nullptr;
+	size_t length = std::min(input.peek(&data), limit);
+	size_t consumed = 0;
+
+	size_t produced = 0;
+	while (produced < frames) {
+		// Pull in input frames until the output position lies between the two frames in the middle of the history
+		while (position >= 1.f) {
+			if (consumed == length) {
+				input.release(consumed);
+				limit -= consumed;
+				consumed = 0;
+				length = std::min(input.peek(&data), limit);
+
+				if (!length) {
+					return produced;
+				}
+			}
+
+			push(data[consumed++]);
+			position -= 1.f;
+		}
+
+		output[produced++] = interpolate<Q>();
+		position += step;
+	}
+
+	input.release(consumed);
+	return produced;
+}
+
+// When the clocks match exactly there is nothing to interpolate
+// This is the same as interpolating at a position of one, the output still lags behind by the history so switching is seamless
+size_t Resampler::copy(RingBuffer& input, uint32_t* output, size_t frames, size_t limit) {
+	size_t produced = 0;
+	while (produced < frames) {
+		const uint32_t* data = nullptr;
+		size_t length = std::min({input.peek(&data), frames - produced, limit});
+		if (!length) {
+			break;
+		}
+
+		for (size_t i = 0; i < length; i++) {
+			push(data[i]);
+			output[produced++] = history[index + CENTER - 1];
+		}
+
+		input.release(length);
+		limit -= length;
+	}
+
+	return produced;
+}
+
+// Dispatch once per call, so the inner loop does not have to branch on the quality
+size_t Resampler::process(RingBuffer& input, uint32_t* output, size_t frames, size_t limit) {
+	// Position is one in between blocks when the ratio is exactly one
+	if (step == 1.f && position == 1.f) {
+		return copy(input, output, frames, limit);
+	}
+
+	switch (quality) {
+		case Quality::LINEAR:
+			return run<Quality::LINEAR>(input, output, frames, limit);
+		case Quality::CUBIC:
+			return run<Quality::CUBIC>(input, output, frames, limit);
+		case Quality::SINC:
+		default:
+			return run<Quality::SINC>(input, output, frames, limit);
+	}
+}
+
+void Resampler::reset() {
+	position = 0;
+	index = 0;
+	std::fill(std::begin(history), std::end(history), 0);
+}
@@ -0,0 +1,92 @@
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+#include "ring_buffer.h"
+
+RingBuffer::RingBuffer(uint32_t* storage, size_t capacity, Overflow overflow) : storage(storage), size(capacity), mask(capacity - 1), overflow(overflow) {
+	assert((capacity & mask) == 0);
+}
+
+RingBuffer::Region RingBuffer::reserve(size_t frames) {
+	Region region;
+
+	size_t free = space();
+	if (frames > free) {
+		overflows.fetch_add(1, std::memory_order_relaxed);
+
+		if (overflow == Overflow::DROP) {
+			dropped.fetch_add(frames, std::memory_order_relaxed);
+			return region;
+		}
+
+		dropped.fetch_add(frames - free, std::memory_order_relaxed);
+		frames = free;
+	}
+
+	// Only the producer modifies the head, so we do not need to synchronize with ourselves
+	size_t offset = head.load(std::memory_order_relaxed) & mask;
+	region.first = storage + offset;
+	region.first_length = std::min(frames, size - offset);
+	if (region.first_length < frames) {
+		region.second = storage;
+		region.second_length = frames - region.first_length;
+	}
+
+	return region;
+}
+
+void RingBuffer::commit(size_t frames) {
+	head.store(head.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+}
+
+// The source does not have to be aligned, which is why this takes a void pointer
+size_t RingBuffer::write(const void* frames, size_t length) {
+	Region region = reserve(length);
+	if (!region.first_length) {
+		return 0;
+	}
+
+	const uint8_t* source = (const uint8_t*)frames;
+	memcpy(region.first, source, region.first_length * sizeof(uint32_t));
+	if (region.second_length) {
+		memcpy(region.second, source + region.first_length * sizeof(uint32_t), region.second_length * sizeof(uint32_t));
+	}
+
+	commit(region.length());
+	return region.length();
+}
+
+size_t RingBuffer::peek(const uint32_t** data) const {
+	uint32_t current = tail.load(std::memory_order_relaxed);
+	size_t offset = current & mask;
+
+	*data = storage + offset;
+	return std::min<size_t>(head.load(std::memory_order_acquire) - current, size - offset);
+}
+
+void RingBuffer::release(size_t frames) {
+	tail.store(tail.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+}
+
+void RingBuffer::underrun() {
+	underruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t RingBuffer::available() const {
+	return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+size_t RingBuffer::space() const {
+	return size - available();
+}
+
+RingBuffer::Stats RingBuffer::get_stats() const {
+	return {
+		.written = head.load(std::memory_order_relaxed),
+		.read = tail.load(std::memory_order_relaxed),
+		.dropped = dropped.load(std::memory_order_relaxed),
+		.overflows = overflows.load(std::memory_order_relaxed),
+		.underruns = underruns.load(std::memory_order_relaxed),
+	};
+}
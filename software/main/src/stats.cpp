@@ -0,0 +1,57 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "stats.h"
+#include "i2s.h"
+#include "audio.h"
+#include "a2dp.h"
+#include "twai.h"
+#include "volume.h"
+#include "meter.h"
+
+#define STATS_TAG "APP_STATS"
+
+static void log_stats(void*) {
+	for (;;) {
+		vTaskDelay(pdMS_TO_TICKS(CONFIG_CAR_STEREO_STATS_INTERVAL * 1000));
+
+		i2s::Stats i2s = i2s::get_stats();
+		ESP_LOGI(STATS_TAG, "buffer: %u/%u frames (target %u), written=%u, read=%u, dropped=%u, overflows=%u, underruns=%u",
+				i2s.fill, i2s.capacity, i2s.target, i2s.buffer.written, i2s.buffer.read, i2s.buffer.dropped, i2s.buffer.overflows, i2s.buffer.underruns);
+		ESP_LOGI(STATS_TAG, "drift: %d ppm (apll %d ppm), jitter: %u frames (%s)", i2s.drift_ppm, i2s.apll_ppm, i2s.jitter, JitterEstimator::get_name(i2s.latency));
+		ESP_LOGI(STATS_TAG, "latency: %u us, reported %u us, dma underruns: %u", i2s.latency_us, a2dp::get_reported_delay_us(), i2s.dma_underruns);
+		ESP_LOGI(STATS_TAG, "stack: processing %u of %u bytes free, output %u bytes free", i2s.task_stack_free, CONFIG_CAR_STEREO_AUDIO_STACK, i2s.output_stack_free);
+
+		i2s::Timing timing = i2s::get_timing();
+		ESP_LOGI(STATS_TAG, "timing: resample=%u, mix=%u, dsp=%u, kernels=%u, total=%u of %u cycles/%u frames, output=%u",
+				timing.resample, timing.mix, timing.dsp, timing.kernels, timing.total, timing.budget, timing.frames, timing.output);
+
+		audio::Stats audio = audio::get_stats();
+		ESP_LOGI(STATS_TAG, "mute: last=%u us, max=%u us, count=%u", audio.mute_latency_us, audio.mute_latency_max_us, audio.mutes);
+		ESP_LOGI(STATS_TAG, "chain: %u cycles/%u frames (max %u), latency=%u us, limiter=-%.1f dB",
+				audio.cycles, audio.frames, audio.cycles_max, audio.latency_us, audio.limiter_reduction_db);
+
+		twai::Stats twai = twai::get_stats();
+		ESP_LOGI(STATS_TAG, "can: steps=%u, cancelled=%u, frames=%u, retries=%u, failed=%u, recoveries=%u, received=%u, malformed=%u, ignored=%u",
+				twai.steps, twai.cancelled, twai.frames, twai.retries, twai.failed, twai.recoveries, twai.received, twai.malformed, twai.ignored);
+
+		volume_controller::Stats volume = volume_controller::get_stats();
+		ESP_LOGI(STATS_TAG, "volume: syncs=%u, interrupted=%u, lost=%u, converged in %u ms (max %u ms)",
+				volume.syncs, volume.interrupted, volume.lost, volume.last_ms, volume.max_ms);
+
+		meter::Snapshot meter = meter::get_snapshot();
+		ESP_LOGI(STATS_TAG, "level: left rms=%.1f peak=%.1f dc=%.4f clips=%u, right rms=%.1f peak=%.1f dc=%.4f clips=%u, silent=%u ms%s",
+				meter.left.rms_db, meter.left.peak_db, meter.left.dc, meter.left.clips,
+				meter.right.rms_db, meter.right.peak_db, meter.right.dc, meter.right.clips,
+				meter.silent_ms, meter.silent ? " (silent)" : "");
+	}
+}
+
+void stats::init() {
+	if (CONFIG_CAR_STEREO_STATS_INTERVAL == 0) {
+		return;
+	}
+
+	xTaskCreatePinnedToCore(log_stats, "Stats", 2048, nullptr, 0, nullptr, 0);
+}
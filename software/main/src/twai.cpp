@@ -1,5 +1,10 @@
 #include <cmath>
 #include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#include <iterator>
+#include <array>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -11,64 +16,304 @@
 #include "config.h"
 #include "avrcp.h"
 #include "can_data.h"
+#include "can_filter.h"
 #include "volume.h"
+#include "audio.h"
 #include "helper.h"
 
 #define TWAI_TAG "APP_TWAI"
 
+// Time a button is held down and the time between two presses, the radio misses presses that are shorter
+#define PRESS_MS CONFIG_CAR_STEREO_CAN_PRESS_MS
+#define GAP_MS CONFIG_CAR_STEREO_CAN_GAP_MS
+// Retries when the bus is busy start after a tick and double up to this
+#define BACKOFF_MAX_MS 80
+// Gives up on a press after this many retries
+#define PRESS_RETRIES 5
+// A release gets more, with the backoff this keeps trying for about two seconds
+#define RELEASE_RETRIES 30
+
 static bool enabled = false;
 
-// @TODO Make sure that the other buttons are set to match the current state
-// That way way the scroll wheel and long pressing will not have unintented effects
-void twai::change_volume(bool up) {
-	// Make sure we only change the volume if we are enabled
-	if (enabled) {
-		can::Buttons buttons;
-		memset(&buttons, 0, sizeof(buttons));
+static TaskHandle_t transmit_handle = nullptr;
+// Volume steps that still have to be sent, positive is up
+// Steps in opposite directions cancel out and steps in the same direction queue up, without anyone having to wait
+static std::atomic<int32_t> pending{0};
+// Set while a press is on the bus
+static std::atomic<bool> pressing{false};
+// Counted by the listener, the transmit task and whoever steps the volume, read by the stats task
+static struct {
+	std::atomic<uint32_t> steps;
+	std::atomic<uint32_t> cancelled;
+	std::atomic<uint32_t> frames;
+	std::atomic<uint32_t> retries;
+	std::atomic<uint32_t> failed;
+	std::atomic<uint32_t> recoveries;
+	std::atomic<uint32_t> received;
+	std::atomic<uint32_t> malformed;
+	std::atomic<uint32_t> ignored;
+} stats;
+
+static twai_message_t to_message(const can::Buttons& buttons) {
+	twai_message_t message;
+	memset(&message, 0, sizeof(message));
+
+	message.identifier = can::Buttons::ID;
+	message.data_length_code = can::Buttons::LENGTH;
+	buttons.encode(message.data);
+
+	for (int i = 0; i < message.data_length_code; i++) {
+		ESP_LOGD(TWAI_TAG, "%i: 0x%X", i, message.data[i]);
+	}
+
+	return message;
+}
+
+// After too many errors the controller goes bus off and stops transmitting until it is recovered and started again
+static void recover() {
+	twai_status_info_t status;
+	if (twai_get_status_info(&status) != ESP_OK) {
+		return;
+	}
 
-		if (up) {
-			buttons.volume_up = true;
-		} else {
-			buttons.volume_down = true;
+	if (status.state == TWAI_STATE_BUS_OFF) {
+		ESP_LOGW(TWAI_TAG, "Bus off, initiating recovery");
+		twai_initiate_recovery();
+		stats.recoveries.fetch_add(1, std::memory_order_relaxed);
+	} else if (status.state == TWAI_STATE_STOPPED) {
+		// The recovery has finished, the driver does not start again on its own
+		if (twai_start() == ESP_OK) {
+			ESP_LOGI(TWAI_TAG, "Driver restarted after bus off");
 		}
+	}
+}
 
-		twai_message_t message;
-		memset(&message, 0, sizeof(message));
+// Never blocks on the driver, if the transmit queue is full or the bus is in trouble we back off and try again
+static bool transmit(const twai_message_t& message, int retries) {
+	TickType_t backoff = 1;
+	for (int attempt = 0; attempt <= retries; attempt++) {
+		esp_err_t result = twai_transmit(&message, 0);
+		if (result == ESP_OK) {
+			stats.frames.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
 
-		message.identifier = BUTTONS_ID;
-		message.data_length_code = 3;
-		message.data[0] = ((uint8_t*)&buttons)[0];
-		message.data[1] = ((uint8_t*)&buttons)[1];
-		message.data[2] = ((uint8_t*)&buttons)[2];
+		if (result == ESP_ERR_INVALID_STATE) {
+			recover();
+		}
 
+		stats.retries.fetch_add(1, std::memory_order_relaxed);
+		vTaskDelay(backoff);
+		backoff = std::min<TickType_t>(backoff * 2, pdMS_TO_TICKS(BACKOFF_MAX_MS));
+	}
 
-		for (int i = 0; i < message.data_length_code; i++) {
-			ESP_LOGI(TWAI_TAG, "%i: 0x%X", i, message.data[i]);
+	stats.failed.fetch_add(1, std::memory_order_relaxed);
+	ESP_LOGW(TWAI_TAG, "Failed to transmit to 0x%X", (unsigned)message.identifier);
+	return false;
+}
+
+// Takes a single step off the pending count, returns the direction or zero if there is nothing to do
+static int32_t claim_step() {
+	int32_t steps = pending.load(std::memory_order_relaxed);
+	while (steps) {
+		int32_t direction = steps > 0 ? 1 : -1;
+		if (pending.compare_exchange_weak(steps, steps - direction, std::memory_order_relaxed)) {
+			return direction;
+		}
+	}
+	return 0;
+}
+
+// @TODO Make sure that the other buttons are set to match the current state
+// That way way the scroll wheel and long pressing will not have unintented effects
+static void transmit_task(void*) {
+	TickType_t wake = xTaskGetTickCount();
+	for (;;) {
+		int32_t direction = claim_step();
+		if (!direction) {
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			wake = xTaskGetTickCount();
+			continue;
+		}
+
+		// Make sure we only change the volume if we are enabled
+		if (!enabled) {
+			pending.store(0, std::memory_order_relaxed);
+			continue;
 		}
 
-		if (twai_transmit(&message, pdMS_TO_TICKS(1000)) == ESP_OK) {
-			ESP_LOGI(TWAI_TAG, "Message queued for transmission");
-		} else {
-			ESP_LOGI(TWAI_TAG, "Failed tp queue message for transmission");
+		can::Buttons buttons = {};
+		buttons.volume_up = direction > 0;
+		buttons.volume_down = direction < 0;
+
+		pressing.store(true, std::memory_order_relaxed);
+		if (transmit(to_message(buttons), PRESS_RETRIES)) {
+			stats.steps.fetch_add(1, std::memory_order_relaxed);
+			// Timed from the press, not from the end of the retries
+			vTaskDelayUntil(&wake, pdMS_TO_TICKS(PRESS_MS));
+
+			buttons.volume_up = false;
+			buttons.volume_down = false;
+			// A button that is never released would keep changing the volume
+			if (!transmit(to_message(buttons), RELEASE_RETRIES)) {
+				ESP_LOGE(TWAI_TAG, "Failed to release the volume button");
+			}
 		}
+		// Cleared even when the release did not go out, otherwise the volume sync never finishes
+		pressing.store(false, std::memory_order_relaxed);
+
+		vTaskDelayUntil(&wake, pdMS_TO_TICKS(GAP_MS));
+	}
+}
+
+void twai::change_volume(bool up) {
+	step_volume(up ? 1 : -1);
+}
+
+bool twai::step_volume(int32_t steps) {
+	if (!enabled) {
+		return false;
+	}
+
+	int32_t before = pending.fetch_add(steps, std::memory_order_relaxed);
+	if (before && (before > 0) != (steps > 0)) {
+		stats.cancelled.fetch_add(2 * std::min(std::abs(before), std::abs(steps)), std::memory_order_relaxed);
+	}
+	xTaskNotifyGive(transmit_handle);
+	return true;
+}
+
+int32_t twai::cancel_volume() {
+	return pending.exchange(0, std::memory_order_relaxed);
+}
+
+int32_t twai::get_pending_steps() {
+	return pending.load(std::memory_order_relaxed);
+}
+
+bool twai::volume_idle() {
+	return !pending.load(std::memory_order_relaxed) && !pressing.load(std::memory_order_relaxed);
+}
+
+twai::Stats twai::get_stats() {
+	return {
+		.steps = stats.steps.load(std::memory_order_relaxed),
+		.cancelled = stats.cancelled.load(std::memory_order_relaxed),
+		.frames = stats.frames.load(std::memory_order_relaxed),
+		.retries = stats.retries.load(std::memory_order_relaxed),
+		.failed = stats.failed.load(std::memory_order_relaxed),
+		.recoveries = stats.recoveries.load(std::memory_order_relaxed),
+		.received = stats.received.load(std::memory_order_relaxed),
+		.malformed = stats.malformed.load(std::memory_order_relaxed),
+		.ignored = stats.ignored.load(std::memory_order_relaxed),
+	};
+}
+
+static void on_buttons(const can::Buttons& buttons) {
+	if (!enabled) {
+		return;
+	}
+
+	static MultiPurposeButton button_forward(avrcp::play_pause, avrcp::forward);
+	button_forward.update(buttons.forward);
 
-		vTaskDelay(pdMS_TO_TICKS(50));
+	static MultiPurposeButton button_backward(nullptr, avrcp::backward);
+	button_backward.update(buttons.backward);
 
-		buttons.volume_up = false;
-		buttons.volume_down = false;
-		message.data[0] = ((uint8_t*)&buttons)[0];
+	// @TODO Figure out what we want to do with the scroll button
+	// Fast foward only appears to work in jellyfin and only skips 5 seconds
+	// The scrolling also seems very unresponsive
+	// So yeah...
+	static uint8_t scroll = 0;
+	if (scroll != buttons.scroll) {
+		scroll = buttons.scroll;
+		ESP_LOGI(TWAI_TAG, "Scroll changed: 0x%X", buttons.scroll);
+	}
 
-		for (int i = 0; i < message.data_length_code; i++) {
-			ESP_LOGI(TWAI_TAG, "%i: 0x%X", i, message.data[i]);
+	// If the volume is syncing make sure we can cancel it if we press the volume buttons in the car
+	if (buttons.volume_up || buttons.volume_down) {
+		volume_controller::cancel_sync();
+	}
+}
+
+static void on_volume(const can::Volume& volume) {
+	if (enabled) {
+		// Only update the volume if the volume has actually changed
+		volume_controller::set_from_radio(volume.volume);
+	}
+}
+
+static void on_radio(const can::Radio& radio) {
+	bool previous = enabled;
+	enabled = (radio.source == can::Source::AUX2) && (radio.enabled);
+
+	// If we just changed into the disabled state => pause
+	if (!enabled && previous) {
+		avrcp::pause();
+	}
+
+	static bool muted = false;
+	static bool was_playing = false;
+	// If we just muted => fade out locally right away and pause as a follow up
+	// The phone can take hundreds of milliseconds to actually stop
+	if (!muted && radio.muted) {
+		audio::set_muted(true);
+		was_playing = avrcp::is_playing();
+		avrcp::pause();
+	}
+
+	// If we just unmuted => fade back in and unpause if we were playing before muting
+	if (muted && !radio.muted) {
+		audio::set_muted(false);
+		if (was_playing) {
+			avrcp::play();
 		}
+	}
+	muted = radio.muted;
 
-		if (twai_transmit(&message, pdMS_TO_TICKS(1000)) == ESP_OK) {
-			ESP_LOGI(TWAI_TAG, "Message queued for transmission");
-		} else {
-			ESP_LOGI(TWAI_TAG, "Failed tp queue message for transmission");
+	// @TODO Figure out how all of this works when we receive a call
+	// If I remember correctly when receiving a call, the radio muted the input
+	// In which case it should auto resume playing after finishing the call
+	// However the phone probably automatically pauses and unpauses the music during a call.
+	// So we probably don't really have to do anything here.
+}
+
+static constexpr can::Handler handlers[] = {
+	can::handler<can::Radio, on_radio>(),
+	can::handler<can::Volume, on_volume>(),
+	can::handler<can::Buttons, on_buttons>(),
+};
+
+static constexpr bool unique_ids() {
+	for (size_t i = 0; i < std::size(handlers); i++) {
+		for (size_t j = i + 1; j < std::size(handlers); j++) {
+			if (handlers[i].id == handlers[j].id) {
+				return false;
+			}
 		}
 	}
+	return true;
 }
+static_assert(unique_ids(), "Every message can only have a single handler");
+
+// Every extra ID that gets through the hardware filter wakes up the listener for nothing
+#define MAX_FALSE_POSITIVES 8
+
+static constexpr std::array<uint16_t, std::size(handlers)> subscribed = [] {
+	std::array<uint16_t, std::size(handlers)> ids = {};
+	for (size_t i = 0; i < ids.size(); i++) {
+		ids[i] = handlers[i].id;
+	}
+	return ids;
+}();
+
+static constexpr can::Filter filter = can::make_filter(subscribed);
+static constexpr auto false_positives = can::false_positives<can::count_false_positives(filter, subscribed)>(filter, subscribed);
+static_assert(can::verify(filter, subscribed), "The acceptance filter drops a message we listen to");
+static_assert(false_positives.size() <= MAX_FALSE_POSITIVES, "The acceptance filter lets through too many other messages");
+
+// Drops whatever the hardware filter could not
+static constexpr can::IdSet accepted(subscribed);
 
 static void listen(void*) {
 	for (;;) {
@@ -77,83 +322,17 @@ static void listen(void*) {
 			ESP_LOGI(TWAI_TAG, "Failed to receive message");
 			continue;
 		}
+		stats.received.fetch_add(1, std::memory_order_relaxed);
 
-		if (message.extd) {
-			ESP_LOGI(TWAI_TAG, "Message is in Extended Format");
+		// The filter only knows about standard IDs, an extended frame can look like one of ours
+		if (message.extd || !accepted.contains(message.identifier)) {
+			stats.ignored.fetch_add(1, std::memory_order_relaxed);
+			continue;
 		}
 
-		switch (message.identifier) {
-			case BUTTONS_ID:
-				if (enabled) {
-					can::Buttons buttons = can::convert<can::Buttons>(message.data, message.data_length_code);
-
-					static MultiPurposeButton button_forward(avrcp::play_pause, avrcp::forward);
-					button_forward.update(buttons.forward);
-
-					static MultiPurposeButton button_backward(nullptr, avrcp::backward);
-					button_backward.update(buttons.backward);
-
-					// @TODO Figure out what we want to do with the scroll button
-					// Fast foward only appears to work in jellyfin and only skips 5 seconds
-					// The scrolling also seems very unresponsive
-					// So yeah...
-					static uint8_t scroll = 0;
-					if (scroll != buttons.scroll) {
-						scroll = buttons.scroll;
-						ESP_LOGI(TWAI_TAG, "Scroll changed: 0x%X", buttons.scroll);
-					}
-
-					// If the volume is syncing make sure we can cancel it if we press the volume buttons in the car
-					if (buttons.volume_up || buttons.volume_down) {
-						volume_controller::cancel_sync();
-					}
-				}
-				break;
-
-			case VOLUME_ID:
-				if (enabled) {
-					can::Volume volume = can::convert<can::Volume>(message.data, message.data_length_code);
-					// Only update the volume if the volume has actually changed
-					volume_controller::set_from_radio(volume.volume);
-				}
-				break;
-
-			case RADIO_ID:
-				{
-					can::Radio radio = can::convert<can::Radio>(message.data, message.data_length_code);
-					bool previous = enabled;
-					enabled = (radio.source == can::Source::AUX2) && (radio.enabled);
-
-					// If we just changed into the disabled state => pause
-					if (!enabled && previous) {
-						avrcp::pause();
-					}
-
-					static bool muted = false;
-					static bool was_playing = false;
-					// If we just muted => pause
-					if (!muted && radio.muted) {
-						was_playing = avrcp::is_playing();
-						avrcp::pause();
-					}
-
-					// If we just unmuted and were playing before muting => unpause
-					if (muted && !radio.muted && was_playing) {
-						avrcp::play();
-					}
-					muted = radio.muted;
-
-					// @TODO Figure out how all of this works when we receive a call
-					// If I remember correctly when receiving a call, the radio muted the input
-					// In which case it should auto resume playing after finishing the call
-					// However the phone probably automatically pauses and unpauses the music during a call.
-					// So we probably don't really have to do anything here.
-				}
-				break;
-
-
-			default:
-				break;
+		if (can::dispatch(handlers, message.identifier, message.rtr, message.data_length_code, message.data) == can::Dispatch::MALFORMED) {
+			stats.malformed.fetch_add(1, std::memory_order_relaxed);
+			ESP_LOGD(TWAI_TAG, "Malformed frame 0x%X with length %u", (unsigned)message.identifier, message.data_length_code);
 		}
 	}
 }
@@ -162,11 +341,17 @@ void twai::init() {
 	twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(TWAI_PIN_CTX, TWAI_PIN_CRX, TWAI_MODE_NORMAL);
 	twai_timing_config_t t_config = TWAI_TIMING_CONFIG_125KBITS();
 	twai_filter_config_t f_config = {
-		.acceptance_code = (0b100100101 << 5) + (0b1000011111 << 21),
-		.acceptance_mask = (0b011000000 << 5) + 0b11111 + (0b11111 << 16),
-		.single_filter = false
+		.acceptance_code = filter.acceptance_code(),
+		.acceptance_mask = filter.acceptance_mask(),
+		.single_filter = filter.single
 	};
 
+	ESP_LOGI(TWAI_TAG, "Acceptance filter: code=0x%08X, mask=0x%08X (%s), %u false positives",
+			(unsigned)f_config.acceptance_code, (unsigned)f_config.acceptance_mask, filter.single ? "single" : "dual", (unsigned)false_positives.size());
+	for (uint16_t id : false_positives) {
+		ESP_LOGD(TWAI_TAG, "False positive: 0x%03X", id);
+	}
+
 	if (twai_driver_install(&g_config, &t_config, &f_config) == ESP_OK) {
 		ESP_LOGI(TWAI_TAG, "Driver installed");
 	} else {
@@ -181,4 +366,6 @@ void twai::init() {
 	}
 
 	xTaskCreatePinnedToCore(listen, "TWAI Listener", 2048, nullptr, 0, nullptr, 0);
+	// Above the listener, so a release goes out on time
+	xTaskCreatePinnedToCore(transmit_task, "TWAI Transmit", 2048, nullptr, 1, &transmit_handle, 0);
 }
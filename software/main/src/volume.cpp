@@ -1,15 +1,29 @@
 #include <cmath>
+#include <cstdlib>
+#include <algorithm>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "volume.h"
 #include "avrcp.h"
 #include "twai.h"
+#include "audio.h"
 
 #define VOLUME_TAG "APP_VOLUME"
 
+// Steps that are not reported by the radio within this time after they went out were missed
+#define FEEDBACK_TIMEOUT_US 500000
+// How often we check on the steps while some are in flight
+#define POLL_MS 100
+
+#ifdef CONFIG_CAR_STEREO_HYBRID_VOLUME
+#define RADIO_DB_PER_STEP (CONFIG_CAR_STEREO_RADIO_STEP_TENTH_DB / 10.f)
+#define HEADROOM ((float)CONFIG_CAR_STEREO_VOLUME_HEADROOM)
+#endif
+
 // 0-127
 static uint8_t volume;
 // 0-127
@@ -18,8 +32,36 @@ static uint8_t remote_volume;
 static uint8_t radio_volume;
 
 static bool synced = true;
+// Steps handed to twai that the radio has not reported yet
+// The radio is going to end up at radio_volume + rising - falling, so we never ask for a step twice
+// Kept apart because after a change of direction there can be steps both ways on their way to the radio
+static int32_t rising = 0;
+static int32_t falling = 0;
+static int64_t sync_start = 0;
+// Last time the steps made progress, either on the bus or in a report of the radio
+static int64_t last_progress = 0;
+static volume_controller::Stats stats = {};
 static _lock_t lock;
 
+static TaskHandle_t task_handle = nullptr;
+
+// Takes the steps that were not sent yet out of the accounting, has to be called with the lock held
+static void drop_pending() {
+	int32_t dropped = twai::cancel_volume();
+	if (dropped > 0) {
+		rising -= dropped;
+	} else {
+		falling += dropped;
+	}
+}
+
+static void wake() {
+	if (task_handle) {
+		xTaskNotifyGive(task_handle);
+	}
+}
+
+#ifndef CONFIG_CAR_STEREO_HYBRID_VOLUME
 // Helper functions for converting between internal volume level and radio volume level
 // Since most of the time we are going to be around a radio volume of 15 the scaling is non-linear
 static uint8_t to_radio_volume(uint8_t volume) {
@@ -31,27 +73,104 @@ static uint8_t from_radio_volume(uint8_t volume) {
 	return ceil(volume * 4.2f);
 	/* return floor((127.f / sqrt(30.f)) * sqrt(volume)); */
 }
+#else
+// The volume we want as a fractional radio step
+static float exact_radio_volume(uint8_t volume) {
+	return volume / 4.2f;
+}
+
+// The radio sits a few steps above the volume we want, so the digital gain can follow the phone instantly in both directions
+// The headroom shrinks towards both ends, so 0 and 30 are still reached and every radio step maps back to a volume
+static float with_headroom(float exact) {
+	return std::min({2 * exact, exact + HEADROOM, (30 + exact) / 2});
+}
+
+// Inverse of with_headroom
+static float without_headroom(float radio) {
+	return std::max({radio / 2, radio - HEADROOM, 2 * radio - 30});
+}
+
+static uint8_t to_radio_volume_target(uint8_t volume) {
+	return std::clamp<int>(ceil(with_headroom(exact_radio_volume(volume))), 0, 30);
+}
+
+// Makes up the difference between the volume we want and what the radio is actually at
+// Called whenever either of them changes, so a change on the phone is heard within one audio block
+static void update_digital_volume() {
+	_lock_acquire(&lock);
+	float exact = exact_radio_volume(volume);
+	uint8_t radio = radio_volume;
+	_lock_release(&lock);
+
+	// The bottom step fades out linearly instead of stopping at some level
+	float db = std::min((exact - radio) * RADIO_DB_PER_STEP, 0.f);
+	audio::set_gain(powf(10.f, db / 20.f) * std::min(exact, 1.f));
+
+	// The loudness compensation should follow what we actually hear
+	audio::set_radio_volume(std::max<int>(lrintf(exact), 0));
+}
+#endif
 
 void volume_controller::cancel_sync() {
-	synced = true;
+	// Steps that are already on the bus still land, the reports of the radio account for those
+	_lock_acquire(&lock);
+	drop_pending();
+	if (!synced) {
+		synced = true;
+		stats.interrupted++;
+	}
+	_lock_release(&lock);
 }
 
 void volume_controller::set_from_radio(int v) {
 	/* ESP_LOGI(VOLUME_TAG, "Volume on radio updated: %i (0-30)", v); */
+	bool intervention = false;
+
 	// Update the radio volume
 	_lock_acquire(&lock);
+	int32_t delta = v - radio_volume;
 	radio_volume = v;
+
+	// Our own steps arriving
+	int32_t& expected = delta > 0 ? rising : falling;
+	int32_t ours = std::min(std::abs(delta), expected);
+	if (ours) {
+		expected -= ours;
+		last_progress = esp_timer_get_time();
+	}
+
+	// More than we asked for in that direction, so someone used the knob
+	if (std::abs(delta) > ours && !synced) {
+		intervention = true;
+	}
 	_lock_release(&lock);
 
+	if (intervention) {
+		ESP_LOGI(VOLUME_TAG, "Radio moved against the sync, giving up");
+		cancel_sync();
+	}
+
+#ifdef CONFIG_CAR_STEREO_HYBRID_VOLUME
+	update_digital_volume();
+#else
+	audio::set_radio_volume(v);
+#endif
+
 	if (!synced) {
-		ESP_LOGI(VOLUME_TAG, "Not updating internal and remote (SYNCING)");
+		ESP_LOGD(VOLUME_TAG, "Not updating internal and remote (SYNCING)");
 		// In this case we are still adjusting the volume of the car to match the remote/internal volume
 		// So we do not want to update these values based on the radio
+		wake();
 		return;
 	}
 
+#ifdef CONFIG_CAR_STEREO_HYBRID_VOLUME
+	// The radio minus the headroom is what we hear now, rounded down so it maps back onto the same radio step
+	uint8_t full_range = std::min<int>(floorf(without_headroom(v) * 4.2f), 127);
+#else
 	// Convert the 0 - 30 range of the radio to 0 - 127
 	uint8_t full_range = from_radio_volume(v);
+#endif
 	if (full_range == volume) {
 		return;
 	}
@@ -66,6 +185,10 @@ void volume_controller::set_from_radio(int v) {
 	volume = full_range;
 	remote_volume = full_range;
 	_lock_release(&lock);
+
+#ifdef CONFIG_CAR_STEREO_HYBRID_VOLUME
+	update_digital_volume();
+#endif
 }
 
 void volume_controller::set_from_remote(int v) {
@@ -75,34 +198,101 @@ void volume_controller::set_from_remote(int v) {
 	remote_volume = v;
 	volume = v;
 
+	if (synced) {
+		sync_start = esp_timer_get_time();
+		stats.syncs++;
+	}
 	synced = false;
 	_lock_release(&lock);
+
+	wake();
+
+#ifdef CONFIG_CAR_STEREO_HYBRID_VOLUME
+	// The radio catches up in the background, the digital gain takes care of the change right away
+	update_digital_volume();
+#endif
 }
 
 uint8_t volume_controller::current() {
 	return volume;
 }
 
-static void correct_volume(void*) {
-	for (;;) {
-		if (!synced) {
-			uint8_t target = to_radio_volume(volume);
-
-			if (radio_volume == target) {
-				ESP_LOGI(VOLUME_TAG, "Synced");
-				_lock_acquire(&lock);
-				synced = true;
-				_lock_release(&lock);
+volume_controller::Stats volume_controller::get_stats() {
+	_lock_acquire(&lock);
+	Stats s = stats;
+	_lock_release(&lock);
+	return s;
+}
+
+// Works out all the steps the radio needs to reach the target and hands them to twai at once
+// Returns how long to wait before checking again if nothing else happens
+static TickType_t reconcile() {
+	int64_t now = esp_timer_get_time();
+
+	_lock_acquire(&lock);
+	if (synced) {
+		_lock_release(&lock);
+		return portMAX_DELAY;
+	}
+
+#ifdef CONFIG_CAR_STEREO_HYBRID_VOLUME
+	int32_t target = to_radio_volume_target(volume);
+#else
+	int32_t target = to_radio_volume(volume);
+#endif
+
+	// The timeout only starts once the last press is released
+	if (!twai::volume_idle()) {
+		last_progress = now;
+	} else if ((rising || falling) && now - last_progress > FEEDBACK_TIMEOUT_US) {
+		ESP_LOGW(VOLUME_TAG, "Radio did not report %li steps", (long)(rising + falling));
+		stats.lost += rising + falling;
+		rising = 0;
+		falling = 0;
+	}
+
+	int32_t steps = target - (radio_volume + rising - falling);
+	if (steps) {
+		// Whatever is still queued is replaced by the steps that are needed now, so a change of direction does not wait for the old steps
+		drop_pending();
+		steps = target - (radio_volume + rising - falling);
+
+		// Queued with the lock held, so cancel_sync can not miss them, twai never blocks
+		if (steps && twai::step_volume(steps)) {
+			if (steps > 0) {
+				rising += steps;
 			} else {
-				/* ESP_LOGI(VOLUME_TAG, "Adjusting volume: %i", radio_volume < target); */
-				twai::change_volume(radio_volume < target);
+				falling -= steps;
 			}
 		}
+		last_progress = now;
+	}
 
-		vTaskDelay(pdMS_TO_TICKS(50));
+	uint32_t duration = 0;
+	bool done = !rising && !falling && radio_volume == target;
+	if (done) {
+		duration = (now - sync_start) / 1000;
+		synced = true;
+		stats.last_ms = duration;
+		stats.max_ms = std::max(stats.max_ms, duration);
+	}
+	_lock_release(&lock);
+
+	if (done) {
+		ESP_LOGI(VOLUME_TAG, "Synced in %u ms", (unsigned)duration);
+		return portMAX_DELAY;
+	}
+
+	return pdMS_TO_TICKS(POLL_MS);
+}
+
+static void correct_volume(void*) {
+	for (;;) {
+		// Woken up by every change of the target and every report of the radio
+		ulTaskNotifyTake(pdTRUE, reconcile());
 	}
 }
 
 void volume_controller::init() {
-	xTaskCreatePinnedToCore(correct_volume, "Correct volume", 2048, nullptr, 0, nullptr, 0);
+	xTaskCreatePinnedToCore(correct_volume, "Correct volume", 2048, nullptr, 0, &task_handle, 0);
 }
@@ -1,65 +1,171 @@
+#include <cstring>
+#include <algorithm>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_log.h"
-#include "driver/i2s.h"
 
 #include "wav.h"
-#include "i2s.h"
+#include "mixer.h"
+#include "adpcm.h"
+#include "riff.h"
+#include "prompts.h"
+#include "command_queue.h"
 
 #define WAV_TAG "APP_WAV"
-#define WAV_HEADER_SIZE 44
-#define I2S_BUFFER_SIZE 512
+#define WAV_CHUNK_FRAMES 256
+#define WAV_QUEUE_SIZE 8
+
+struct Prompt {
+	riff::Wave wave;
+	wav::Priority priority;
+};
 
-struct PlayWavParam {
-	const uint8_t* data;
-	uint32_t len;
+struct Playing {
+	Prompt prompt;
+	mixer::Voice* voice;
+	adpcm::Decoder decoder;
+	// Position in samples per channel, only used for PCM
+	uint32_t position;
 };
 
-static void task(void* param) {
+static CommandQueue<Prompt, WAV_QUEUE_SIZE> commands;
+static TaskHandle_t task_handle = nullptr;
+
+// The prompt that is currently playing and the one that plays after it
+static Playing current = {};
+static Prompt pending = {};
+
+static void start(const Prompt& prompt) {
+	// The sample is mixed into the stream and resampled to its rate, so i2s does not have to be reclocked and the music keeps playing
+	mixer::Voice* voice = mixer::acquire(prompt.wave.format.sample_rate);
+	if (!voice) {
+		ESP_LOGE(WAV_TAG, "No voice available, dropping prompt");
+		return;
+	}
+
 	ESP_LOGI(WAV_TAG, "Playing sample...");
-	PlayWavParam* p = (PlayWavParam*)param;
+	current = {prompt, voice, {}, 0};
+	if (prompt.wave.format.encoding == riff::IMA_ADPCM) {
+		current.decoder.open(prompt.wave);
+	}
+}
 
-	// Switch to mono since the samples are all in mono to save space
-	i2s_zero_dma_buffer(I2S_PORT);
-	i2s_set_clk(I2S_PORT, 44100, 16, I2S_CHANNEL_MONO);
+static uint32_t remaining(const Playing& playing) {
+	if (playing.prompt.wave.format.encoding == riff::IMA_ADPCM) {
+		return playing.decoder.remaining();
+	}
 
-	for (uint32_t index = 0; index < p->len; index += I2S_BUFFER_SIZE) {
-		int rest = p->len - index;
+	return playing.prompt.wave.samples - playing.position;
+}
 
-		size_t byte_size = I2S_BUFFER_SIZE;
-		if (rest < I2S_BUFFER_SIZE) {
-			byte_size = rest;
-		}
+// Reads straight from the data chunk, which is either embedded in the app or mapped from the prompts partition
+static size_t decode(Playing& playing, uint32_t* frames, size_t length) {
+	if (playing.prompt.wave.format.encoding == riff::IMA_ADPCM) {
+		return playing.decoder.decode(frames, length);
+	}
 
-		const unsigned char* current = p->data + WAV_HEADER_SIZE + index;
-		size_t bytes_written;
-		if (i2s_write(I2S_PORT, current, byte_size, &bytes_written, portMAX_DELAY) != ESP_OK) {
-			ESP_LOGE(WAV_TAG, "i2s_write has failed");
-		}
+	const riff::Wave& wave = playing.prompt.wave;
+	length = std::min(length, (size_t)remaining(playing));
+	const uint8_t* data = wave.data + playing.position * wave.format.block_align;
+	playing.position += length;
 
-		if (bytes_written < byte_size) {
-			ESP_LOGE(WAV_TAG, "Timeout: not all bytes were written to I2S");
-		}
+	// 16 bit stereo PCM has the same layout as our frames
+	if (wave.format.channels == 2) {
+		memcpy(frames, data, length * sizeof(uint32_t));
+		return length;
+	}
+
+	// Mono is played on both channels, anything past the first two channels is skipped
+	for (size_t i = 0; i < length; i++) {
+		uint16_t left = riff::read_u16(data);
+		uint16_t right = wave.format.channels == 1 ? left : riff::read_u16(data + 2);
+		frames[i] = left | ((uint32_t)right << 16);
+		data += wave.format.block_align;
+	}
+
+	return length;
+}
+
+// A prompt with the same or a higher priority interrupts the current one, the newest event is the most relevant
+// A prompt with a lower priority plays after the current one, replacing any pending prompt with an equal or lower priority
+static void handle(const Prompt& prompt) {
+	if (!current.voice) {
+		start(prompt);
+	} else if (prompt.priority >= current.prompt.priority) {
+		ESP_LOGI(WAV_TAG, "Interrupting current prompt");
+		mixer::stop(current.voice);
+		current = {};
+		start(prompt);
+	} else if (!pending.wave.valid() || prompt.priority >= pending.priority) {
+		pending = prompt;
+	} else {
+		ESP_LOGW(WAV_TAG, "Dropping low priority prompt");
 	}
+}
 
-	// Switch back to stereo with the correct samplerate
-	i2s_zero_dma_buffer(I2S_PORT);
-	i2s_set_clk(I2S_PORT, i2s::get_sample_rate(), 16, I2S_CHANNEL_STEREO);
+// Decodes straight into the buffer of the voice, returns true once the entire prompt has been handed over
+static bool feed(Playing& playing) {
+	while (remaining(playing)) {
+		RingBuffer::Region region = mixer::reserve(playing.voice, WAV_CHUNK_FRAMES);
+		if (!region.length()) {
+			return false;
+		}
 
-	ESP_LOGI(WAV_TAG, "Done");
+		size_t frames = decode(playing, region.first, region.first_length);
+		frames += decode(playing, region.second, region.second_length);
+		mixer::commit(playing.voice, frames);
+	}
 
-	free(p);
-	vTaskDelete(nullptr);
+	return true;
 }
 
-void wav::play(const uint8_t* start, const uint8_t* end) {
-	ESP_LOGI(WAV_TAG, "Creating Play Wav Task");
-	uint32_t len = (end - start - WAV_HEADER_SIZE);
+static void task(void*) {
+	ESP_LOGI(WAV_TAG, "Starting prompt engine");
+	for (;;) {
+		// Wake up every tick while we are feeding the mixer, otherwise wait for a command
+		ulTaskNotifyTake(pdTRUE, current.voice ? 1 : portMAX_DELAY);
+
+		Prompt prompt;
+		while (commands.pop(prompt)) {
+			handle(prompt);
+		}
+
+		if (current.voice && feed(current)) {
+			mixer::release(current.voice);
+			current = {};
+			ESP_LOGI(WAV_TAG, "Done");
 
-	PlayWavParam* param = new PlayWavParam;
-	param->data = start;
-	param->len = len;
+			if (pending.wave.valid()) {
+				start(pending);
+				pending = {};
+			}
+		}
+	}
+}
 
-	if (xTaskCreatePinnedToCore(task, "PlayWav", 2048, param, configMAX_PRIORITIES - 3, nullptr, 0) != pdPASS) {
-		ESP_LOGE(WAV_TAG, "Failed to create play wav task");
+void wav::init() {
+	prompts::init();
+
+	if (xTaskCreatePinnedToCore(task, "Prompts", 2048, nullptr, configMAX_PRIORITIES - 3, &task_handle, 0) != pdPASS) {
+		ESP_LOGE(WAV_TAG, "Failed to create prompt task");
 	}
 }
 
+// Does not allocate or block, so it can be called from anywhere
+void wav::play(const char* name, Priority priority) {
+	Prompt prompt = {
+		.wave = prompts::find(name),
+		.priority = priority,
+	};
+	if (!prompt.wave.valid()) {
+		return;
+	}
+
+	if (!commands.push(prompt)) {
+		ESP_LOGE(WAV_TAG, "Prompt queue is full");
+		return;
+	}
+
+	xTaskNotifyGive(task_handle);
+}
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Packs prompts for the firmware, either as a header that embeds them in the app or as an image for the prompts partition.
+
+    prompts.py header output.h NAME=file.wav...
+        Emits constexpr arrays that are parsed and validated at compile time, see main/include/riff.h.
+
+    prompts.py partition output.bin NAME=file.wav...
+        Emits a RIFF file of form type "PRMT" holding a "name" chunk followed by the wav file itself for every prompt.
+        Prompts in the partition replace the embedded prompt with the same name, without reflashing the app:
+            parttool.py write_partition --partition-name prompts --input output.bin
+"""
+
+import struct
+import sys
+
+NAME_SIZE = 16
+
+
+def read_prompts(arguments):
+    prompts = []
+    for argument in arguments:
+        name, _, path = argument.partition("=")
+        if not name.isidentifier() or len(name) >= NAME_SIZE or not path:
+            sys.exit(f"invalid prompt '{argument}', expected NAME=file.wav")
+
+        with open(path, "rb") as f:
+            data = f.read()
+
+        if data[0:4] != b"RIFF" or data[8:12] != b"WAVE":
+            sys.exit(f"{path}: not a RIFF/WAVE file")
+
+        prompts.append((name, data))
+
+    return prompts
+
+
+def header(prompts):
+    lines = [
+        "// Generated by scripts/prompts.py, do not edit",
+        "#pragma once",
+        "",
+        "#include <cstdint>",
+        "",
+        '#include "riff.h"',
+        "",
+        "namespace assets {",
+        "\tstruct Asset {",
+        "\t\tconst char* name;",
+        "\t\triff::Wave wave;",
+        "\t};",
+        "",
+    ]
+
+    for name, data in prompts:
+        lines.append(f"\tinline constexpr uint8_t {name}[] = {{")
+        for start in range(0, len(data), 16):
+            lines.append("\t\t" + " ".join(f"0x{byte:02x}," for byte in data[start:start + 16]))
+        lines.append("\t};")
+        lines.append("")
+
+    lines.append("\tinline constexpr Asset table[] = {")
+    for name, _ in prompts:
+        lines.append(f'\t\t{{"{name}", riff::parse({name}, sizeof({name}))}},')
+    lines.append("\t};")
+    lines.append("")
+
+    for index, (name, _) in enumerate(prompts):
+        lines.append(f'\tstatic_assert(table[{index}].wave.valid(), "Prompt {name} is not a supported wav file");')
+    lines.append("}")
+
+    return "\n".join(lines) + "\n"
+
+
+def chunk(chunk_id, data):
+    return chunk_id + struct.pack("<I", len(data)) + data + b"\0" * (len(data) & 1)
+
+
+def partition(prompts):
+    body = b"PRMT"
+    for name, data in prompts:
+        body += chunk(b"name", name.encode().ljust(NAME_SIZE, b"\0"))
+        # A wav file is a RIFF chunk itself, so it can be added as is
+        body += data + b"\0" * (len(data) & 1)
+
+    return b"RIFF" + struct.pack("<I", len(body)) + body
+
+
+def main():
+    if len(sys.argv) < 4 or sys.argv[1] not in ("header", "partition"):
+        sys.exit(f"usage: {sys.argv[0]} header|partition output NAME=file.wav...")
+
+    prompts = read_prompts(sys.argv[3:])
+    if sys.argv[1] == "header":
+        with open(sys.argv[2], "w") as f:
+            f.write(header(prompts))
+    else:
+        with open(sys.argv[2], "wb") as f:
+            f.write(partition(prompts))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""Converts a 16 bit PCM wav file into an IMA-ADPCM wav file (format 0x11) that the firmware decodes while streaming.
+
+Every block starts with a four byte header per channel:
+    int16    first sample, also the initial predictor
+    uint8    step index
+    uint8    reserved
+after which the channels alternate in groups of four bytes holding eight samples, low nibble first.
+"""
+
+import struct
+import sys
+
+# Bytes per block and channel, the usual block size for 22.05 kHz mono
+CHANNEL_BLOCK_SIZE = 256
+
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767,
+]
+
+
+def read_wav(path):
+    """Walks the RIFF chunks instead of assuming a 44 byte header."""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    if data[0:4] != b"RIFF" or data[8:12] != b"WAVE":
+        sys.exit(f"{path}: not a RIFF/WAVE file")
+
+    fmt = None
+    samples = None
+    offset = 12
+    while offset + 8 <= len(data):
+        chunk_id = data[offset:offset + 4]
+        (size,) = struct.unpack_from("<I", data, offset + 4)
+        body = data[offset + 8:offset + 8 + size]
+
+        if chunk_id == b"fmt ":
+            fmt = struct.unpack_from("<HHIIHH", body)
+        elif chunk_id == b"data":
+            samples = body
+
+        # Chunks are padded to an even size
+        offset += 8 + size + (size & 1)
+
+    if fmt is None or samples is None:
+        sys.exit(f"{path}: missing fmt or data chunk")
+
+    audio_format, channels, sample_rate, _, _, bits = fmt
+    if audio_format != 1 or bits != 16:
+        sys.exit(f"{path}: only 16 bit PCM is supported")
+
+    count = len(samples) // (2 * channels)
+    interleaved = struct.unpack_from(f"<{count * channels}h", samples)
+    return sample_rate, [list(interleaved[c::channels]) for c in range(channels)]
+
+
+def encode_sample(sample, predictor, index):
+    step = STEP_TABLE[index]
+    difference = sample - predictor
+
+    nibble = 0
+    if difference < 0:
+        nibble = 8
+        difference = -difference
+
+    # Has to match the reconstruction in the decoder exactly
+    delta = step >> 3
+    if difference >= step:
+        nibble |= 4
+        difference -= step
+        delta += step
+    if difference >= step >> 1:
+        nibble |= 2
+        difference -= step >> 1
+        delta += step >> 1
+    if difference >= step >> 2:
+        nibble |= 1
+        delta += step >> 2
+
+    predictor = predictor - delta if nibble & 8 else predictor + delta
+    predictor = max(-32768, min(32767, predictor))
+    index = max(0, min(88, index + INDEX_TABLE[nibble]))
+
+    return nibble, predictor, index
+
+
+def encode_block(block, index):
+    """Encodes one block of a single channel, returns the header, the nibbles and the new step index."""
+    predictor = block[0]
+    header = struct.pack("<hBB", predictor, index, 0)
+
+    nibbles = []
+    for sample in block[1:]:
+        nibble, predictor, index = encode_sample(sample, predictor, index)
+        nibbles.append(nibble)
+
+    data = bytes(low | (high << 4) for low, high in zip(nibbles[0::2], nibbles[1::2]))
+    return header, data, index
+
+
+def encode(sample_rate, channels):
+    count = len(channels[0])
+    block_align = CHANNEL_BLOCK_SIZE * len(channels)
+    block_samples = (CHANNEL_BLOCK_SIZE - 4) * 2 + 1
+
+    data = bytearray()
+    indices = [0] * len(channels)
+    for start in range(0, count, block_samples):
+        headers = []
+        bodies = []
+        for c, samples in enumerate(channels):
+            block = samples[start:start + block_samples]
+            # Pad the last block, the fact chunk tells the decoder where to stop
+            block += [0] * (block_samples - len(block))
+
+            header, body, indices[c] = encode_block(block, indices[c])
+            headers.append(header)
+            bodies.append(body)
+
+        data += b"".join(headers)
+        for group in range(0, len(bodies[0]), 4):
+            for body in bodies:
+                data += body[group:group + 4]
+
+    byte_rate = sample_rate * block_align // block_samples
+    fmt = struct.pack("<HHIIHHHH", 0x11, len(channels), sample_rate, byte_rate, block_align, 4, 2, block_samples)
+    fact = struct.pack("<I", count)
+
+    body = b"WAVE"
+    for chunk_id, chunk in ((b"fmt ", fmt), (b"fact", fact), (b"data", data)):
+        body += chunk_id + struct.pack("<I", len(chunk)) + chunk + b"\0" * (len(chunk) & 1)
+
+    return b"RIFF" + struct.pack("<I", len(body)) + body
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(f"usage: {sys.argv[0]} input.wav output.wav")
+
+    sample_rate, channels = read_wav(sys.argv[1])
+    with open(sys.argv[2], "wb") as f:
+        f.write(encode(sample_rate, channels))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,70 @@
+#include <cstdio>
+#include <vector>
+
+#include "adpcm.h"
+#include "test.h"
+
+// The vectors are made by vectors/generate.py with scripts/wav2adpcm.py, the decoder has to match the encoder bit for bit
+static std::vector<uint8_t> load(const char* name) {
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%s", VECTORS, name);
+
+	std::vector<uint8_t> data;
+	FILE* file = fopen(path, "rb");
+	CHECK(file);
+	if (!file) {
+		return data;
+	}
+
+	uint8_t buffer[4096];
+	size_t length;
+	while ((length = fread(buffer, 1, sizeof(buffer), file))) {
+		data.insert(data.end(), buffer, buffer + length);
+	}
+	fclose(file);
+	return data;
+}
+
+static void vector(const char* adpcm, const char* pcm, uint16_t channels) {
+	std::vector<uint8_t> encoded = load(adpcm);
+	std::vector<uint8_t> expected = load(pcm);
+
+	riff::Wave wave = riff::parse(encoded.data(), encoded.size());
+	CHECK(wave.valid());
+	CHECK(wave.format.encoding == riff::IMA_ADPCM);
+	CHECK(wave.format.channels == channels);
+	CHECK(wave.samples == expected.size() / (2 * channels));
+	if (!wave.valid()) {
+		return;
+	}
+
+	adpcm::Decoder decoder;
+	decoder.open(wave);
+
+	// An odd length, so decode calls end in the middle of groups and blocks
+	std::vector<uint32_t> frames;
+	uint32_t buffer[37];
+	size_t length;
+	while ((length = decoder.decode(buffer, 37))) {
+		frames.insert(frames.end(), buffer, buffer + length);
+	}
+	CHECK(decoder.remaining() == 0);
+	CHECK(frames.size() == wave.samples);
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < frames.size() && i < wave.samples; i++) {
+		const uint8_t* sample = &expected[2 * channels * i];
+		uint16_t left = riff::read_u16(sample);
+		// Mono is played on both channels
+		uint16_t right = channels == 2 ? riff::read_u16(sample + 2) : left;
+		mismatches += frames[i] != (left | ((uint32_t)right << 16));
+	}
+	printf("%s: %zu frames, %zu mismatches\n", adpcm, frames.size(), mismatches);
+	CHECK(mismatches == 0);
+}
+
+int main() {
+	vector("mono_adpcm.wav", "mono.pcm", 1);
+	vector("stereo_adpcm.wav", "stereo.pcm", 2);
+	return result();
+}
@@ -0,0 +1,85 @@
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#include "drift.h"
+#include "apll.h"
+#include "test.h"
+
+#define SAMPLE_RATE 44100.
+#define BLOCK 256
+#define PACKET 128
+#define TARGET 2048
+
+struct Result {
+	// Trim of the clock at the end
+	int32_t ppm;
+	// Worst distance between the smoothed fill and the target after settling
+	double error;
+	// Lowest raw fill, zero means an underrun
+	double minimum;
+	// Times the APLL was reprogrammed after settling
+	int reprograms;
+};
+
+// Like the i2s task with the APLL, the drift controller steers the clock of i2s instead of the resampler
+static Result simulate(double offset_ppm, double seconds) {
+	DriftController drift(DRIFT_KP, DRIFT_KI, DRIFT_LIMIT);
+	drift.set_target(TARGET);
+	apll::Trim trim;
+
+	double packet_period = PACKET / (SAMPLE_RATE * (1 + offset_ppm * 1e-6));
+	double now = 0;
+	double next_packet = 0;
+	double fill = TARGET;
+
+	Result result = {0, 0, fill, 0};
+	while (now < seconds) {
+		bool reprogram = trim.update(drift.update(fill));
+		// The block takes as long as the trimmed clock needs for it
+		now += BLOCK / (SAMPLE_RATE * trim.get_ratio());
+		while (next_packet <= now) {
+			fill += PACKET;
+			next_packet += packet_period;
+		}
+		fill -= BLOCK;
+		result.minimum = std::min(result.minimum, fill);
+
+		if (now > seconds / 2) {
+			result.error = std::max(result.error, std::fabs((double)drift.get_fill() - TARGET));
+			result.reprograms += reprogram;
+		}
+	}
+
+	result.ppm = trim.get_ppm();
+	return result;
+}
+
+int main() {
+	// Whole steps only, with a step of hysteresis
+	apll::Trim trim;
+	CHECK(!trim.update(1.f + 1.5e-6f));
+	CHECK(trim.get_ppm() == 0);
+	CHECK(trim.update(1.f + 3e-6f));
+	CHECK(trim.get_ppm() % APLL_STEP_PPM == 0);
+	CHECK(!trim.update(1.f + 2.5e-6f));
+	CHECK(trim.update(1.f - 80.4e-6f));
+	CHECK(trim.get_ppm() == -80);
+	trim.reset();
+	CHECK(trim.get_ratio() == 1.f);
+
+	// Crystals are specified at +-50 ppm or so, leave a good margin on both sides
+	for (double offset : {-300.0, -50.0, 0.0, 80.0, 500.0}) {
+		Result r = simulate(offset, 600);
+		printf("offset=%6.0f ppm: apll=%+4d ppm, error=%4.1f frames, minimum=%6.0f, %d reprograms after settling\n",
+				offset, (int)r.ppm, r.error, r.minimum, r.reprograms);
+
+		CHECK_NEAR(r.ppm, offset, APLL_STEP_PPM);
+		CHECK(r.error < 32);
+		CHECK(r.minimum > TARGET / 4);
+		// Every reprogram is a small step in pitch, once settled it should only follow the packets now and then
+		CHECK(r.reprograms < 30);
+	}
+
+	return result();
+}
@@ -0,0 +1,134 @@
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+
+#include "resampler.h"
+#include "kernels.h"
+#include "naive.h"
+#include "dsp.h"
+
+// Host version of src/benchmark.cpp, for comparing implementations without flashing
+// Only the relative cost means something here, the ESP32 has no SIMD and a much slower FPU
+#define BENCHMARK_ITERATIONS 20000
+#define BENCHMARK_BUFFER_FRAMES (4 * 1024)
+#define BENCHMARK_PACKET_FRAMES 256
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the compiler from dropping work whose result is never used
+static uint32_t sink;
+
+static void report(const char* name, Clock::duration elapsed, uint32_t frames) {
+	printf("%-24s %6.2f ns/frame\n", name, (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / frames);
+}
+
+static void resampler(Resampler::Quality quality, const char* name) {
+	static uint32_t storage[BENCHMARK_BUFFER_FRAMES];
+	static uint32_t output[BENCHMARK_PACKET_FRAMES];
+	RingBuffer input(storage, BENCHMARK_BUFFER_FRAMES);
+
+	Resampler resampler(quality);
+	resampler.set_ratio(44100.f / 48000);
+
+	Clock::duration elapsed(0);
+	uint32_t frames = 0;
+	uint32_t n = 0;
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		RingBuffer::Region region = input.reserve(input.space());
+		for (size_t j = 0; j < region.first_length; j++, n++) {
+			region.first[j] = n * 0x00070003u;
+		}
+		for (size_t j = 0; j < region.second_length; j++, n++) {
+			region.second[j] = n * 0x00070003u;
+		}
+		input.commit(region.length());
+
+		Clock::time_point start = Clock::now();
+		size_t produced = resampler.process(input, output, BENCHMARK_PACKET_FRAMES);
+		elapsed += Clock::now() - start;
+
+		frames += produced;
+		sink += output[produced - 1];
+	}
+
+	char label[32];
+	snprintf(label, sizeof(label), "Resampler %s", name);
+	report(label, elapsed, frames);
+}
+
+static void kernel(const char* name, void (*f)(uint32_t*, size_t)) {
+	static uint32_t frames[BENCHMARK_PACKET_FRAMES];
+	for (size_t i = 0; i < BENCHMARK_PACKET_FRAMES; i++) {
+		frames[i] = i * 0x01230123u;
+	}
+
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		f(frames, BENCHMARK_PACKET_FRAMES);
+		sink += frames[i % BENCHMARK_PACKET_FRAMES];
+	}
+	report(name, Clock::now() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+}
+
+static void kernel(const char* name, void (*f)(const uint32_t*, uint32_t*, size_t)) {
+	static uint32_t frames[BENCHMARK_PACKET_FRAMES];
+	static uint32_t output[BENCHMARK_PACKET_FRAMES * 2];
+
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		frames[i % BENCHMARK_PACKET_FRAMES] = i;
+		f(frames, output, BENCHMARK_PACKET_FRAMES);
+		sink += output[(2 * i) % (2 * BENCHMARK_PACKET_FRAMES)];
+	}
+	report(name, Clock::now() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+}
+
+static void channel_kernels() {
+	kernel("Swap naive", naive::swap);
+	kernel("Swap", kernels::swap);
+	kernel("Downmix naive", naive::downmix);
+	kernel("Downmix", kernels::downmix);
+	kernel("Invert naive", naive::invert);
+	kernel("Invert", kernels::invert);
+	kernel("Expand naive", naive::expand);
+	kernel("Expand", kernels::expand);
+}
+
+// The same stages, once fused into a single pass and once as separate passes over the block
+static void chain() {
+	static uint32_t frames[BENCHMARK_PACKET_FRAMES];
+
+	static dsp::Chain<dsp::Gain, dsp::Swap, dsp::Invert> fused;
+	fused.get<dsp::Gain>().set(0.5f);
+
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		fused.process(frames, BENCHMARK_PACKET_FRAMES);
+		sink += frames[i % BENCHMARK_PACKET_FRAMES];
+	}
+	report("Chain fused", Clock::now() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+
+	static dsp::Chain<dsp::Gain> gain;
+	static dsp::Chain<dsp::Swap> swap;
+	static dsp::Chain<dsp::Invert> invert;
+	gain.get<dsp::Gain>().set(0.5f);
+
+	start = Clock::now();
+	for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		gain.process(frames, BENCHMARK_PACKET_FRAMES);
+		swap.process(frames, BENCHMARK_PACKET_FRAMES);
+		invert.process(frames, BENCHMARK_PACKET_FRAMES);
+		sink += frames[i % BENCHMARK_PACKET_FRAMES];
+	}
+	report("Chain sequential", Clock::now() - start, BENCHMARK_ITERATIONS * BENCHMARK_PACKET_FRAMES);
+}
+
+int main() {
+	resampler(Resampler::Quality::LINEAR, "linear");
+	resampler(Resampler::Quality::CUBIC, "cubic");
+	resampler(Resampler::Quality::SINC, "sinc");
+	channel_kernels();
+	chain();
+
+	printf("(%u)\n", sink & 1);
+}
@@ -0,0 +1,157 @@
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+#include "can_data.h"
+#include "test.h"
+
+// Every value of the field goes in and comes back out, and only touches the bits of the field
+// Wide fields only get the values at the ends and a few bit patterns
+static void field(can::Field field) {
+	uint32_t mask = can::mask(field);
+	bool exhaustive = field.width <= 12;
+	const uint32_t patterns[] = {0, 1, mask / 2, mask / 2 + 1, mask - 1, mask, 0xA5A5A5 & mask, 0x5A5A5A & mask};
+	for (uint32_t i = 0; exhaustive ? i <= mask : i < std::size(patterns); i++) {
+		uint32_t value = exhaustive ? i : patterns[i];
+		for (uint8_t background : {0x00, 0xFF}) {
+			uint8_t data[8];
+			memset(data, background, sizeof(data));
+			can::set(data, field, value);
+			CHECK(can::get(data, field) == value);
+
+			for (size_t bit = 0; bit < 64; bit++) {
+				bool inside = bit >= field.offset && bit < field.offset + field.width;
+				bool set = data[bit / 8] & (1u << (bit % 8));
+				if (inside) {
+					CHECK(set == (bool)(value & (1u << (bit - field.offset))));
+				} else {
+					CHECK(set == (bool)background);
+				}
+			}
+		}
+	}
+
+	// Values that do not fit are cut off instead of spilling into the next field
+	uint8_t data[8] = {};
+	can::set(data, field, mask + 1);
+	CHECK(can::get(data, field) == 0);
+}
+
+template <typename M>
+static bool same(const uint8_t* a, const uint8_t* b) {
+	return memcmp(a, b, M::LENGTH) == 0;
+}
+
+// Every field of the message at its extremes, the other fields and bits are left alone
+template <typename M>
+static void message() {
+	for (can::Field f : M::FIELDS) {
+		field(f);
+
+		for (uint32_t value : {0u, can::mask(f)}) {
+			for (uint8_t background : {0x00, 0xFF}) {
+				uint8_t in[8];
+				memset(in, background, sizeof(in));
+				can::set(in, f, value);
+
+				uint8_t out[8];
+				memset(out, background, sizeof(out));
+				M::decode(in).encode(out);
+				CHECK(same<M>(in, out));
+			}
+		}
+	}
+}
+
+static can::Radio radio;
+static can::Volume volume;
+static int handled = 0;
+
+static void on_radio(const can::Radio& r) {
+	radio = r;
+	handled++;
+}
+
+static void on_volume(const can::Volume& v) {
+	volume = v;
+	handled++;
+}
+
+// Same as the handlers in twai.cpp
+static constexpr can::Handler handlers[] = {
+	can::handler<can::Radio, on_radio>(),
+	can::handler<can::Volume, on_volume>(),
+};
+
+int main() {
+	message<can::Radio>();
+	message<can::Buttons>();
+	message<can::Volume>();
+
+	// A field across two bytes
+	field({6, 4});
+	field({4, 24});
+
+	// Known payloads
+	{
+		uint8_t data[can::Radio::LENGTH] = {0x80, 0x00, 0x50, 0x00};
+		can::Radio r = can::Radio::decode(data);
+		CHECK(r.enabled && !r.muted && !r.cd_changer_available);
+		CHECK(r.source == can::AUX2);
+		CHECK(r.disk_status == can::Init);
+
+		uint8_t encoded[can::Radio::LENGTH] = {};
+		can::Radio{.muted = true, .enabled = true, .cd_changer_available = true, .disk_status = can::Available, .source = can::Bluetooth}.encode(encoded);
+		const uint8_t expected[can::Radio::LENGTH] = {0xA0, 0x50, 0x70, 0x00};
+		CHECK(same<can::Radio>(encoded, expected));
+	}
+	{
+		uint8_t data[can::Buttons::LENGTH] = {0x08, 0x7F, 0x00};
+		can::Buttons b = can::Buttons::decode(data);
+		CHECK(b.volume_up && !b.volume_down && !b.forward && !b.backward && !b.source);
+		CHECK(b.scroll == 0x7F);
+
+		uint8_t encoded[can::Buttons::LENGTH] = {};
+		can::Buttons{.source = true, .volume_down = true, .volume_up = false, .backward = true, .forward = true, .scroll = 0xFF}.encode(encoded);
+		const uint8_t expected[can::Buttons::LENGTH] = {0xC6, 0xFF, 0x00};
+		CHECK(same<can::Buttons>(encoded, expected));
+	}
+	{
+		// The volume only has 5 bits, the rest of the byte is not ours
+		uint8_t data[can::Volume::LENGTH] = {0xFF};
+		CHECK(can::Volume::decode(data).volume == 31);
+		data[0] = 0xF1;
+		CHECK(can::Volume::decode(data).volume == 17);
+		data[0] = 0x00;
+		CHECK(can::Volume::decode(data).volume == 0);
+
+		uint8_t encoded[can::Volume::LENGTH] = {0xE0};
+		can::Volume{.volume = 30}.encode(encoded);
+		CHECK(encoded[0] == 0xFE);
+	}
+
+	// The handler is only called for a frame of the right length that is not a remote request
+	uint8_t data[8] = {0x80, 0x00, 0x50, 0x00, 0xFF, 0xFF, 0xFF, 0xFF};
+	CHECK(can::dispatch(handlers, can::Radio::ID, false, can::Radio::LENGTH, data) == can::Dispatch::HANDLED);
+	CHECK(handled == 1);
+	CHECK(radio.enabled && radio.source == can::AUX2);
+
+	for (uint8_t length = 0; length <= 8; length++) {
+		if (length != can::Radio::LENGTH) {
+			CHECK(can::dispatch(handlers, can::Radio::ID, false, length, data) == can::Dispatch::MALFORMED);
+		}
+		if (length != can::Volume::LENGTH) {
+			CHECK(can::dispatch(handlers, can::Volume::ID, false, length, data) == can::Dispatch::MALFORMED);
+		}
+	}
+	CHECK(can::dispatch(handlers, can::Radio::ID, true, can::Radio::LENGTH, data) == can::Dispatch::MALFORMED);
+	CHECK(can::dispatch(handlers, can::Buttons::ID, false, can::Buttons::LENGTH, data) == can::Dispatch::IGNORED);
+	CHECK(handled == 1);
+
+	data[0] = 0x14;
+	CHECK(can::dispatch(handlers, can::Volume::ID, false, can::Volume::LENGTH, data) == can::Dispatch::HANDLED);
+	CHECK(handled == 2);
+	CHECK(volume.volume == 20);
+
+	return result();
+}
@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <array>
+
+#include "can_data.h"
+#include "can_filter.h"
+#include "test.h"
+
+// Model of the acceptance filter of the TWAI controller, written from the register description of the SJA1000
+// ACR0-3 and AMR0-3 are the code and the mask from the most significant byte down, a set bit in the mask is not compared
+// Single: ID in 31-21, RTR in 20, 19-16 are not used, the first data byte in 15-8 and the second in 7-0
+// Dual: the first filter is ID in 31-21, RTR in 20 and the first data byte split over 19-16 and 3-0,
+// the second filter is ID in 15-5 and RTR in 4
+struct Frame {
+	uint16_t id;
+	bool rtr;
+	uint8_t data[2];
+	// Whatever the controller has in the bits that are not used
+	uint8_t unused;
+};
+
+static bool compare(uint32_t bits, uint32_t code, uint32_t mask, uint32_t compared) {
+	return ((bits ^ code) & ~mask & compared) == 0;
+}
+
+static bool hardware_accepts(bool single, uint32_t code, uint32_t mask, const Frame& frame) {
+	if (single) {
+		uint32_t bits = ((uint32_t)frame.id << 21) | ((uint32_t)frame.rtr << 20) | ((uint32_t)(frame.unused & 0xF) << 16) |
+				((uint32_t)frame.data[0] << 8) | frame.data[1];
+		return compare(bits, code, mask, 0xFFFFFFFF);
+	}
+
+	uint32_t first = ((uint32_t)frame.id << 21) | ((uint32_t)frame.rtr << 20) | ((uint32_t)(frame.data[0] >> 4) << 16) | (frame.data[0] & 0xF);
+	uint32_t second = ((uint32_t)frame.id << 5) | ((uint32_t)frame.rtr << 4);
+	return compare(first, code, mask, 0xFFFF000F) || compare(second, code, mask, 0x0000FFF0);
+}
+
+// Sweeps every standard ID with a few payloads and both RTR states through the registers the driver gets
+template <size_t N>
+static void sweep(const char* name, const std::array<uint16_t, N>& ids) {
+	can::Filter filter = can::make_filter(ids);
+	uint32_t code = filter.acceptance_code();
+	uint32_t mask = filter.acceptance_mask();
+
+	size_t accepted = 0;
+	size_t mismatches = 0;
+	for (uint16_t id = 0; id <= can::STANDARD_ID_MASK; id++) {
+		bool any = false;
+		bool all = true;
+		for (bool rtr : {false, true}) {
+			for (uint8_t data : {0x00, 0x5A, 0xA5, 0xFF}) {
+				for (uint8_t unused : {0x0, 0xF}) {
+					bool ok = hardware_accepts(filter.single, code, mask, {id, rtr, {data, (uint8_t)~data}, unused});
+					any |= ok;
+					all &= ok;
+				}
+			}
+		}
+
+		// Only the ID decides, and it decides the same way as the pattern the filter was built from
+		mismatches += any != all || all != filter.accepts(id);
+		if (can::contains(ids, id)) {
+			CHECK(all);
+		}
+		accepted += all;
+	}
+
+	printf("%s: %s, code=0x%08X, mask=0x%08X, %zu accepted for %zu IDs\n",
+			name, filter.single ? "single" : "dual", (unsigned)code, (unsigned)mask, accepted, N);
+	CHECK(mismatches == 0);
+	CHECK(accepted == filter.accepted());
+	CHECK(accepted == N + can::count_false_positives(filter, ids));
+	CHECK(can::verify(filter, ids));
+
+	can::IdSet set(ids);
+	for (uint16_t id = 0; id <= can::STANDARD_ID_MASK; id++) {
+		CHECK(set.contains(id) == can::contains(ids, id));
+	}
+	CHECK(!set.contains(can::STANDARD_ID_MASK + 1));
+}
+
+int main() {
+	// Same as the handlers in twai.cpp
+	sweep("handlers", std::array<uint16_t, 3>{can::Radio::ID, can::Volume::ID, can::Buttons::ID});
+
+	sweep("one", std::array<uint16_t, 1>{0x123});
+	sweep("ends", std::array<uint16_t, 2>{0x000, 0x7FF});
+	sweep("neighbours", std::array<uint16_t, 2>{0x400, 0x401});
+	sweep("apart", std::array<uint16_t, 2>{0x0F0, 0x70F});
+	sweep("pairs", std::array<uint16_t, 4>{0x100, 0x101, 0x6F0, 0x6F8});
+	sweep("many", std::array<uint16_t, 8>{0x012, 0x0A5, 0x165, 0x1A5, 0x21F, 0x3C0, 0x555, 0x7E0});
+
+	return result();
+}
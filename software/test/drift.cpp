@@ -0,0 +1,124 @@
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+#include "drift.h"
+#include "test.h"
+
+#define SAMPLE_RATE 44100.
+#define BLOCK 256
+#define PACKET 512
+#define TARGET 2048
+// The correction is averaged over windows of this length, the raw one follows the jitter of every packet
+#define WINDOW_S 60.
+
+struct Result {
+	// Mean correction over the last window, should match the clock offset
+	double ppm;
+	// Worst distance between the smoothed fill and the target after settling
+	double error;
+	// Lowest raw fill, zero means an underrun
+	double minimum;
+	// Largest change of the correction between two blocks after settling, this is heard as pitch modulation
+	double slew_ppm;
+	// Start of the first window from which on the mean correction stays within 10% of the offset
+	double settle_s;
+};
+
+// The phone sends packets at its own clock with jitter on the arrival, we consume a block at a time at ours
+static Result simulate(DriftController& drift, double offset_ppm, double jitter_ms, double seconds) {
+	drift.set_target(TARGET);
+
+	std::mt19937 rng(1);
+	std::normal_distribution<double> jitter(0, jitter_ms / 1000);
+
+	double packet_period = PACKET / (SAMPLE_RATE * (1 + offset_ppm * 1e-6));
+	double block_period = BLOCK / SAMPLE_RATE;
+
+	// Arrivals are a clock with jitter on top, late packets can not overtake each other
+	double sent = 0;
+	double next_packet = 0;
+	double next_block = 0;
+	double fill = TARGET;
+
+	Result result = {0, 0, fill, 0, -1};
+	float previous = 1;
+	double window_start = 0;
+	double sum = 0;
+	size_t count = 0;
+	while (next_block < seconds) {
+		if (next_packet < next_block) {
+			fill += PACKET;
+			sent += packet_period;
+			next_packet = std::max(next_packet, sent + std::fabs(jitter(rng)));
+			continue;
+		}
+
+		float ratio = drift.update(std::max(0.0, fill));
+		fill -= BLOCK * ratio;
+		result.minimum = std::min(result.minimum, fill);
+
+		sum += ratio - 1;
+		count++;
+		if (next_block >= window_start + WINDOW_S) {
+			result.ppm = sum / count * 1e6;
+			bool settled = std::fabs(result.ppm - offset_ppm) <= std::max(std::fabs(offset_ppm) * 0.1, 10.0);
+			if (!settled) {
+				result.settle_s = -1;
+			} else if (result.settle_s < 0) {
+				result.settle_s = window_start;
+			}
+
+			window_start = next_block;
+			sum = 0;
+			count = 0;
+		}
+
+		if (next_block > seconds / 2) {
+			result.error = std::max(result.error, std::fabs((double)drift.get_fill() - TARGET));
+			result.slew_ppm = std::max(result.slew_ppm, std::fabs(ratio - previous) * 1e6);
+		}
+		previous = ratio;
+
+		next_block += block_period;
+	}
+
+	return result;
+}
+
+int main() {
+	// Crystals are specified at +-50 ppm or so, leave a good margin on both sides
+	for (double offset : {-300.0, -100.0, 0.0, 50.0, 100.0, 300.0, 500.0}) {
+		DriftController drift(DRIFT_KP, DRIFT_KI, DRIFT_LIMIT);
+		Result r = simulate(drift, offset, 4, 600);
+		printf("offset=%6.0f ppm: correction=%7.1f ppm, settled after %5.1f s, error=%5.1f frames, minimum=%6.0f, slew=%.2f ppm/block\n",
+				offset, r.ppm, r.settle_s, r.error, r.minimum, r.slew_ppm);
+
+		CHECK_NEAR(r.ppm, offset, std::max(std::fabs(offset) * 0.05, 10.0));
+		CHECK(r.settle_s >= 0 && r.settle_s <= 240);
+		CHECK(r.error < 128);
+		CHECK(r.minimum > TARGET / 4);
+		// A few ppm is far below what can be heard as a change in pitch
+		CHECK(r.slew_ppm < 10);
+	}
+
+	// Past the limit the correction saturates instead of running away
+	DriftController saturated(DRIFT_KP, DRIFT_KI, DRIFT_LIMIT);
+	Result r = simulate(saturated, 3000, 4, 240);
+	CHECK_NEAR(r.ppm, DRIFT_LIMIT * 1e6, 1);
+
+	// After a reset the controller settles on a new stream as if it was new, none of the old correction is left
+	saturated.reset();
+	CHECK(saturated.get_ratio() == 1.f);
+	DriftController fresh(DRIFT_KP, DRIFT_KI, DRIFT_LIMIT);
+	Result restarted = simulate(saturated, -100, 4, 600);
+	Result expected = simulate(fresh, -100, 4, 600);
+	printf("after reset: correction=%7.1f ppm, settled after %5.1f s, error=%5.1f frames\n", restarted.ppm, restarted.settle_s, restarted.error);
+	CHECK(restarted.settle_s >= 0 && restarted.settle_s <= 240);
+	CHECK(restarted.settle_s == expected.settle_s);
+	CHECK(restarted.ppm == expected.ppm);
+	CHECK(restarted.error == expected.error);
+
+	return result();
+}
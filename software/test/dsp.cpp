@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "dsp.h"
+#include "test.h"
+
+// Built once with float and once with fixed point samples
+#define FRAMES 256
+
+static uint32_t frame(int16_t left, int16_t right) {
+	return (uint16_t)left | ((uint32_t)(uint16_t)right << 16);
+}
+
+static int16_t left(uint32_t frame) {
+	return (int16_t)frame;
+}
+
+static int16_t right(uint32_t frame) {
+	return (int16_t)(frame >> 16);
+}
+
+static void fill(uint32_t* frames, size_t length) {
+	uint32_t seed = 207;
+	for (size_t i = 0; i < length; i++) {
+		seed = seed * 1664525 + 1013904223;
+		frames[i] = seed;
+	}
+}
+
+// Counts the calls, to check the chain calls begin and end once per block
+struct Counter {
+	int begins = 0;
+	int ends = 0;
+	size_t frames = 0;
+
+	void begin(size_t length) { begins++; }
+	void end() { ends++; }
+
+	dsp::Frame process(dsp::Frame frame) {
+		frames++;
+		return frame;
+	}
+};
+
+static void round_trip() {
+	// An empty chain only unpacks and packs, which has to be lossless
+	uint32_t frames[FRAMES];
+	fill(frames, FRAMES);
+	frames[0] = frame(-32768, 32767);
+
+	uint32_t expected[FRAMES];
+	std::copy(frames, frames + FRAMES, expected);
+
+	dsp::Chain<dsp::Optional<false, dsp::Swap>> chain;
+	chain.process(frames, FRAMES);
+	CHECK(std::equal(frames, frames + FRAMES, expected));
+	// A disabled stage does not take any memory either
+	CHECK(sizeof(chain) == 1);
+}
+
+static void hooks() {
+	uint32_t frames[FRAMES] = {};
+	dsp::Chain<Counter, dsp::Swap> chain;
+	chain.process(frames, FRAMES);
+	chain.process(frames, 10);
+
+	Counter& counter = chain.get<Counter>();
+	CHECK(counter.begins == 2);
+	CHECK(counter.ends == 2);
+	CHECK(counter.frames == FRAMES + 10);
+}
+
+static void gain() {
+	uint32_t frames[FRAMES];
+	std::fill(frames, frames + FRAMES, frame(16000, -16000));
+
+	dsp::Chain<dsp::Gain> chain;
+	chain.get<dsp::Gain>().set(0.5f);
+	chain.process(frames, FRAMES);
+
+	// Ramps over the block, so there is no step
+	bool monotonic = true;
+	int max_step = 0;
+	for (size_t i = 1; i < FRAMES; i++) {
+		monotonic &= left(frames[i]) <= left(frames[i - 1]) && right(frames[i]) >= right(frames[i - 1]);
+		max_step = std::max(max_step, abs(left(frames[i]) - left(frames[i - 1])));
+	}
+	CHECK(monotonic);
+	CHECK(max_step <= 8000 / FRAMES + 1);
+	CHECK(abs(left(frames[FRAMES - 1]) - 8000) <= 1);
+	CHECK(abs(right(frames[FRAMES - 1]) + 8000) <= 1);
+
+	// And stays there on the next block
+	std::fill(frames, frames + FRAMES, frame(16000, -16000));
+	chain.process(frames, FRAMES);
+	CHECK(std::all_of(frames, frames + FRAMES, [](uint32_t f) { return f == frame(8000, -8000); }));
+}
+
+static void mute() {
+	uint32_t frames[FRAMES];
+	dsp::Chain<dsp::Mute> chain;
+	dsp::Mute& mute = chain.get<dsp::Mute>();
+
+	mute.set(true);
+	std::fill(frames, frames + FRAMES, frame(10000, 10000));
+	chain.process(frames, FRAMES);
+
+	// Fades out within DSP_MUTE_FADE_FRAMES and then stays silent
+	CHECK(left(frames[0]) > 9900);
+	CHECK(left(frames[DSP_MUTE_FADE_FRAMES / 2]) > 4900 && left(frames[DSP_MUTE_FADE_FRAMES / 2]) < 5100);
+	CHECK(std::all_of(frames + DSP_MUTE_FADE_FRAMES, frames + FRAMES, [](uint32_t f) { return f == 0; }));
+	CHECK(mute.silent());
+
+	mute.set(false);
+	CHECK(!mute.silent());
+	std::fill(frames, frames + FRAMES, frame(10000, 10000));
+	chain.process(frames, FRAMES);
+	CHECK(left(frames[0]) < 100);
+	CHECK(std::all_of(frames + DSP_MUTE_FADE_FRAMES, frames + FRAMES, [](uint32_t f) { return f == frame(10000, 10000); }));
+}
+
+static void swap_invert() {
+	uint32_t frames[] = {frame(1000, -2000), frame(-32768, 32767)};
+	dsp::Chain<dsp::Swap, dsp::Invert> chain;
+	chain.process(frames, 2);
+
+	CHECK(left(frames[0]) == 2000 && right(frames[0]) == -1000);
+	// Negating full scale negative saturates
+	CHECK(left(frames[1]) == -32767 && right(frames[1]) == 32767);
+}
+
+// A fused chain has to give the same result as running the stages one after another,
+// apart from the rounding in between the passes
+static void fused() {
+	uint32_t a[FRAMES];
+	uint32_t b[FRAMES];
+	fill(a, FRAMES);
+	std::copy(a, a + FRAMES, b);
+
+	dsp::Chain<dsp::Gain, dsp::Swap, dsp::Invert> fused;
+	dsp::Chain<dsp::Gain> gain;
+	dsp::Chain<dsp::Swap> swap;
+	dsp::Chain<dsp::Invert> invert;
+	fused.get<dsp::Gain>().set(0.5f);
+	gain.get<dsp::Gain>().set(0.5f);
+
+	int max_difference = 0;
+	for (int block = 0; block < 3; block++) {
+		fused.process(a, FRAMES);
+		gain.process(b, FRAMES);
+		swap.process(b, FRAMES);
+		invert.process(b, FRAMES);
+
+		for (size_t i = 0; i < FRAMES; i++) {
+			max_difference = std::max({max_difference, abs(left(a[i]) - left(b[i])), abs(right(a[i]) - right(b[i]))});
+		}
+	}
+	CHECK(max_difference <= 1);
+}
+
+int main() {
+	round_trip();
+	hooks();
+	gain();
+	mute();
+	swap_invert();
+	fused();
+	return result();
+}
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "eq.h"
+#include "response.h"
+#include "test.h"
+
+// Built once with float and once with fixed point samples
+static const uint32_t rates[] = {16000, 32000, 44100, 48000};
+
+static double response_db(const eq::Band& band, double frequency, uint32_t sample_rate) {
+	return response_db(eq::Bank<1>{eq::design(band, sample_rate)}, frequency, sample_rate);
+}
+
+// Level of a sine after running it through the equalizer, once it settled
+static double measure_db(eq::Preset preset, uint32_t sample_rate, double frequency) {
+	dsp::Chain<eq::Equalizer<EQ_BANDS>> chain;
+	chain.get<eq::Equalizer<EQ_BANDS>>().set(eq::get_bank(preset, sample_rate));
+
+	const double amplitude = 8000;
+	uint32_t block[256];
+	double sum = 0;
+	size_t count = 0;
+	size_t t = 0;
+	size_t blocks = sample_rate / 256;
+	for (size_t b = 0; b < blocks; b++) {
+		for (uint32_t& frame : block) {
+			int16_t sample = (int16_t)lrint(amplitude * sin(2 * M_PI * frequency * t++ / sample_rate));
+			frame = (uint16_t)sample * 0x00010001u;
+		}
+		chain.process(block, 256);
+
+		// Skip the crossfade and the settling of the low bands
+		if (b < blocks / 2) {
+			continue;
+		}
+		for (uint32_t frame : block) {
+			double left = (int16_t)frame;
+			double right = (int16_t)(frame >> 16);
+			sum += left * left + right * right;
+			count += 2;
+		}
+	}
+	return 20 * log10(sqrt(sum / count) / (amplitude / sqrt(2)));
+}
+
+static void bands() {
+	using eq::Type;
+	for (uint32_t rate : rates) {
+		// Exactly the gain at the center and nothing far away from it
+		eq::Band peak = {Type::PEAKING, 1000, -6, 1.4f};
+		CHECK_NEAR(response_db(peak, 1000, rate), -6, 0.01);
+		CHECK_NEAR(response_db(peak, 20, rate), 0, 0.05);
+
+		eq::Band low = {Type::LOW_SHELF, 100, 6, 0.707f};
+		CHECK_NEAR(response_db(low, 10, rate), 6, 0.1);
+		CHECK_NEAR(response_db(low, 100, rate), 3, 0.1);
+		CHECK_NEAR(response_db(low, rate / 2 - 1, rate), 0, 0.05);
+
+		eq::Band high = {Type::HIGH_SHELF, 4000, 3, 0.707f};
+		CHECK_NEAR(response_db(high, 20, rate), 0, 0.05);
+		CHECK_NEAR(response_db(high, 4000, rate), 1.5, 0.1);
+
+		// Butterworth, 3 dB down at the corner
+		eq::Band high_pass = {Type::HIGH_PASS, 100, 0, 0.707f};
+		CHECK_NEAR(response_db(high_pass, 100, rate), -3.01, 0.05);
+		CHECK(response_db(high_pass, 10, rate) < -39);
+		CHECK_NEAR(response_db(high_pass, 1000, rate), 0, 0.05);
+
+		eq::Band low_pass = {Type::LOW_PASS, 4000, 0, 0.707f};
+		CHECK_NEAR(response_db(low_pass, 4000, rate), -3.01, 0.05);
+		CHECK_NEAR(response_db(low_pass, 100, rate), 0, 0.05);
+
+		// Bands at or above the Nyquist frequency are moved below it instead of blowing up
+		eq::Band nyquist = {Type::HIGH_SHELF, (float)rate, 3, 0.707f};
+		CHECK(stable(eq::design(nyquist, rate)));
+	}
+}
+
+static void presets() {
+	for (size_t p = 0; p < (size_t)eq::Preset::COUNT; p++) {
+		eq::Preset preset = (eq::Preset)p;
+		for (uint32_t rate : rates) {
+			eq::Bank<EQ_BANDS> bank = eq::get_bank(preset, rate);
+			CHECK(std::all_of(bank.begin(), bank.end(), stable));
+
+			// The preamp leaves room for every boost, so a preset never clips a full scale signal
+			double peak = -100;
+			for (double f = 10; f < rate / 2; f *= 1.02) {
+				peak = std::max(peak, response_db(bank, f, rate));
+			}
+			CHECK(peak < 0.5);
+		}
+	}
+
+	// The precomputed banks are the same as designing them on the fly
+	eq::Bank<EQ_BANDS> table = eq::get_bank(eq::Preset::CABIN, 44100);
+	eq::Bank<EQ_BANDS> designed = eq::design(eq::Preset::CABIN, 44100);
+	CHECK(memcmp(&table, &designed, sizeof(table)) == 0);
+}
+
+// Flat has to be a true bypass, not just close to one
+static void flat() {
+	dsp::Chain<eq::Equalizer<EQ_BANDS>> chain;
+	chain.get<eq::Equalizer<EQ_BANDS>>().set(eq::get_bank(eq::Preset::FLAT, 44100));
+
+	uint32_t frames[1024];
+	uint32_t seed = 207;
+	for (uint32_t& frame : frames) {
+		seed = seed * 1664525 + 1013904223;
+		frame = seed;
+	}
+
+	uint32_t expected[1024];
+	std::copy(std::begin(frames), std::end(frames), expected);
+	chain.process(frames, 1024);
+	CHECK(std::equal(std::begin(frames), std::end(frames), expected));
+}
+
+// What comes out of the cascade has to match the design
+static void processed() {
+	for (double f : {50., 125., 1000., 2500., 10000.}) {
+		double designed = response_db(eq::get_bank(eq::Preset::CABIN, 44100), f, 44100);
+		double measured = measure_db(eq::Preset::CABIN, 44100, f);
+		printf("cabin %5.0f Hz: designed %6.2f dB, measured %6.2f dB\n", f, designed, measured);
+		CHECK_NEAR(measured, designed, 0.1);
+	}
+}
+
+int main() {
+	bands();
+	presets();
+	flat();
+	processed();
+	return result();
+}
@@ -0,0 +1,43 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "extremes.h"
+#include "test.h"
+
+// One thread raises and lowers while the other takes the extremes, the overall ones can never get lost
+int main() {
+	std::atomic<uint32_t> maximum{0};
+	std::atomic<uint32_t> minimum{UINT32_MAX};
+	std::atomic<bool> done{false};
+
+	uint32_t written_max = 0;
+	uint32_t written_min = UINT32_MAX;
+	std::thread writer([&] {
+		uint32_t seed = 207;
+		for (int i = 0; i < 1000000; i++) {
+			seed = seed * 1664525 + 1013904223;
+			extremes::raise(maximum, seed);
+			extremes::lower(minimum, seed);
+			written_max = std::max(written_max, seed);
+			written_min = std::min(written_min, seed);
+		}
+		done = true;
+	});
+
+	uint32_t taken_max = 0;
+	uint32_t taken_min = UINT32_MAX;
+	auto take = [&] {
+		taken_max = std::max(taken_max, maximum.exchange(0));
+		taken_min = std::min(taken_min, minimum.exchange(UINT32_MAX));
+	};
+	while (!done) {
+		take();
+	}
+	writer.join();
+	take();
+
+	CHECK(taken_max == written_max);
+	CHECK(taken_min == written_min);
+	return result();
+}
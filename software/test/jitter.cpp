@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "jitter.h"
+#include "test.h"
+
+#define RATE 44100
+#define PACKET 512
+
+// Delivers packets of PACKET frames for a while, in bursts of the given amount of packets
+static int64_t stream(JitterEstimator& jitter, int64_t start_us, int seconds, int burst) {
+	int64_t packets = (int64_t)seconds * RATE / PACKET;
+	int64_t time = start_us;
+	for (int64_t i = 0; i < packets; i++) {
+		// Every packet of a burst arrives together with the last one
+		time = start_us + (i / burst * burst + burst - 1) * PACKET * 1000000 / RATE;
+		jitter.arrive(time, PACKET, RATE);
+	}
+	return time;
+}
+
+static void steady(size_t block) {
+	JitterEstimator jitter(block);
+	stream(jitter, 0, 5, 1);
+
+	// The clock of the estimator rounds, a frame of spread is nothing
+	size_t measured = jitter.get_jitter(Latency::LOW);
+	CHECK(measured <= 1);
+	CHECK(jitter.get_target(Latency::LOW) == std::clamp<size_t>(measured + block, 512, 2048));
+	measured = jitter.get_jitter(Latency::NORMAL);
+	CHECK(jitter.get_target(Latency::NORMAL) == std::clamp<size_t>(measured * 150 / 100 + std::max<size_t>(512, block), 1024, 3072));
+}
+
+static void bursts() {
+	JitterEstimator jitter(256);
+	int64_t end = stream(jitter, 0, 5, 3);
+
+	// Packets that arrive together spread over two packets
+	size_t measured = jitter.get_jitter(Latency::NORMAL);
+	printf("bursts of three: %zu frames of jitter\n", measured);
+	CHECK(measured >= 2 * PACKET - 2 && measured <= 2 * PACKET + 2);
+	CHECK(jitter.get_target(Latency::NORMAL) == measured * 150 / 100 + 512);
+
+	// After a pause the history is kept, the new stream only starts a new clock
+	stream(jitter, end + 1000000, 1, 1);
+	CHECK(jitter.get_jitter(Latency::NORMAL) == measured);
+}
+
+int main() {
+	// The margin covers at least one block of the largest block size
+	steady(64);
+	steady(256);
+	steady(1024);
+	bursts();
+	return result();
+}
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "kernels.h"
+#include "naive.h"
+#include "test.h"
+
+// Not a multiple of four, so the tail of the unrolled loops runs as well
+#define FRAMES 1003
+
+static uint32_t input[FRAMES];
+
+static int16_t left(uint32_t frame) {
+	return (int16_t)frame;
+}
+
+static int16_t right(uint32_t frame) {
+	return (int16_t)(frame >> 16);
+}
+
+static void fill() {
+	uint32_t seed = 207;
+	for (uint32_t& frame : input) {
+		seed = seed * 1664525 + 1013904223;
+		frame = seed;
+	}
+
+	// The corners of the range
+	input[0] = 0x80008000;
+	input[1] = 0x7FFF7FFF;
+	input[2] = 0x7FFF8000;
+	input[3] = 0xFFFF0001;
+	input[4] = 0;
+}
+
+static void swap() {
+	uint32_t expected[FRAMES];
+	uint32_t frames[FRAMES];
+	std::copy(input, input + FRAMES, expected);
+	std::copy(input, input + FRAMES, frames);
+
+	naive::swap(expected, FRAMES);
+	kernels::swap(frames, FRAMES);
+	CHECK(std::equal(frames, frames + FRAMES, expected));
+}
+
+static void downmix() {
+	uint32_t expected[FRAMES];
+	uint32_t frames[FRAMES];
+	std::copy(input, input + FRAMES, expected);
+	std::copy(input, input + FRAMES, frames);
+
+	naive::downmix(expected, FRAMES);
+	kernels::downmix(frames, FRAMES);
+
+	// The kernel shifts instead of dividing, so odd negative sums round down instead of towards zero
+	bool matches = true;
+	for (size_t i = 0; i < FRAMES; i++) {
+		matches &= left(frames[i]) == right(frames[i]);
+		matches &= left(frames[i]) - left(expected[i]) == 0 || left(frames[i]) - left(expected[i]) == -1;
+	}
+	CHECK(matches);
+}
+
+static void invert() {
+	uint32_t frames[FRAMES];
+	std::copy(input, input + FRAMES, frames);
+	kernels::invert(frames, FRAMES);
+
+	// Off by one from the negation, but full scale negative turns into full scale positive instead of wrapping
+	bool matches = true;
+	for (size_t i = 0; i < FRAMES; i++) {
+		matches &= left(frames[i]) == -left(input[i]) - 1;
+		matches &= right(frames[i]) == -right(input[i]) - 1;
+	}
+	CHECK(matches);
+	CHECK(frames[0] == 0x7FFF7FFF);
+}
+
+static void expand() {
+	uint32_t expected[2 * FRAMES];
+	uint32_t output[2 * FRAMES];
+
+	naive::expand(input, expected, FRAMES);
+	kernels::expand(input, output, FRAMES);
+	CHECK(std::equal(output, output + 2 * FRAMES, expected));
+}
+
+static void apply() {
+	using kernels::Channels;
+
+	const Channels channels[] = {Channels::STEREO, Channels::SWAPPED, Channels::MONO};
+	for (Channels c : channels) {
+		for (bool inverted : {false, true}) {
+			// The same as running the separate kernels one after another
+			uint32_t expected[FRAMES];
+			std::copy(input, input + FRAMES, expected);
+			if (c == Channels::SWAPPED) {
+				kernels::swap(expected, FRAMES);
+			} else if (c == Channels::MONO) {
+				kernels::downmix(expected, FRAMES);
+			}
+			if (inverted) {
+				kernels::invert(expected, FRAMES);
+			}
+
+			uint32_t frames[FRAMES];
+			std::copy(input, input + FRAMES, frames);
+			kernels::apply(c, inverted, frames, FRAMES);
+			CHECK(std::equal(frames, frames + FRAMES, expected));
+		}
+	}
+}
+
+int main() {
+	fill();
+	swap();
+	downmix();
+	invert();
+	expand();
+	apply();
+	return result();
+}
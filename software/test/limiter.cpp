@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "limiter.h"
+#include "test.h"
+
+// Built once with float and once with fixed point samples
+#define BLOCK 128
+
+using Chain = dsp::Chain<limiter::Limiter>;
+
+static uint32_t frame(int16_t sample) {
+	return (uint16_t)sample * 0x00010001u;
+}
+
+// Runs a signal through the limiter in blocks, returns the output
+template <typename F>
+static std::vector<int16_t> run(Chain& chain, size_t length, F signal) {
+	std::vector<int16_t> output;
+	uint32_t block[BLOCK];
+	for (size_t t = 0; t < length; t += BLOCK) {
+		for (size_t i = 0; i < BLOCK; i++) {
+			block[i] = frame(signal(t + i));
+		}
+		chain.process(block, BLOCK);
+		for (uint32_t f : block) {
+			output.push_back((int16_t)f);
+		}
+	}
+	return output;
+}
+
+// Mostly a quiet signal with the occasional full scale spike, the same as the benchmark on the target
+static void ceiling(bool compress) {
+	Chain chain;
+	limiter::Settings settings;
+	settings.ceiling_db = -1;
+	if (compress) {
+		settings.threshold_db = -18;
+		settings.ratio = 3;
+	}
+	chain.get<limiter::Limiter>().configure(settings);
+
+	uint32_t seed = 1;
+	std::vector<int16_t> output = run(chain, 128 * 1000, [&](size_t) {
+		seed = seed * 1664525 + 1013904223;
+		return ((seed >> 12) & 0xF) ? (int16_t)(((seed >> 20) & 0xFFF) - 2048) : (int16_t)(seed >> 16);
+	});
+
+	int limit = (int)(32767 * powf(10.f, settings.ceiling_db / 20.f)) + 1;
+	size_t over = std::count_if(output.begin(), output.end(), [&](int16_t s) { return abs(s) > limit; });
+	CHECK(over == 0);
+
+	// It did have to work for that
+	float reduction = -20.f * log10f(chain.get<limiter::Limiter>().take_min_gain());
+	CHECK(reduction > 0.5f);
+	CHECK(chain.get<limiter::Limiter>().take_min_gain() == 1.f);
+}
+
+// Below the threshold the signal only gets delayed by the look ahead, sample for sample
+static void transparent() {
+	Chain chain;
+	chain.get<limiter::Limiter>().configure(limiter::Settings{});
+
+	auto signal = [](size_t t) { return (int16_t)lrint(8000 * sin(t * 0.05)); };
+	std::vector<int16_t> output = run(chain, BLOCK * 100, signal);
+
+	bool delayed = true;
+	for (size_t t = LIMITER_LOOKAHEAD_FRAMES; t < output.size(); t++) {
+		delayed &= output[t] == signal(t - LIMITER_LOOKAHEAD_FRAMES);
+	}
+	CHECK(delayed);
+	CHECK(chain.get<limiter::Limiter>().take_min_gain() == 1.f);
+}
+
+// Above the knee the compressor follows its ratio
+static void compressor() {
+	Chain chain;
+	limiter::Settings settings;
+	settings.ceiling_db = 0;
+	settings.threshold_db = -18;
+	settings.ratio = 3;
+	chain.get<limiter::Limiter>().configure(settings);
+
+	// 12 dB over the threshold comes out 4 dB over it
+	double amplitude = 32767 * pow(10, -6 / 20.);
+	std::vector<int16_t> output = run(chain, 44100, [&](size_t t) { return (int16_t)lrint(amplitude * sin(t * 0.05)); });
+
+	int peak = 0;
+	for (size_t t = output.size() / 2; t < output.size(); t++) {
+		peak = std::max(peak, abs(output[t]));
+	}
+	double level = 20 * log10(peak / 32767.);
+	printf("compressor: -6 dBFS in, %.2f dBFS out\n", level);
+	CHECK_NEAR(level, -14, 0.5);
+}
+
+int main() {
+	ceiling(false);
+	ceiling(true);
+	transparent();
+	compressor();
+	return result();
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "loudness.h"
+#include "response.h"
+#include "test.h"
+
+// Built once with float and once with fixed point samples
+static const uint32_t rates[] = {16000, 32000, 44100, 48000};
+
+static void steps() {
+	for (uint32_t rate : rates) {
+		double previous_bass = 0;
+		double previous_treble = 0;
+		for (int step = LOUDNESS_STEPS - 1; step >= 0; step--) {
+			eq::Bank<LOUDNESS_BANDS> bank = loudness::get_bank(step, rate);
+			CHECK(std::all_of(bank.begin(), bank.end(), stable));
+
+			double low = response_db(bank, 20, rate);
+			double middle = response_db(bank, 1000, rate);
+			double high = response_db(bank, rate / 2 - 1, rate);
+			double bass = low - middle;
+			double treble = high - middle;
+
+			// Only ever cuts, the volume itself is analog so a boost could clip
+			double peak = -100;
+			for (double f = 10; f < rate / 2; f *= 1.05) {
+				peak = std::max(peak, response_db(bank, f, rate));
+			}
+			CHECK(peak < 0.05);
+
+			if (step >= LOUDNESS_REFERENCE_STEP) {
+				// No compensation at or above the reference
+				CHECK(peak > -0.05);
+				CHECK_NEAR(bass, 0, 0.05);
+				CHECK_NEAR(treble, 0, 0.05);
+			} else {
+				// Every step down brings out a bit more of the low and high end
+				CHECK(bass > previous_bass);
+				CHECK(treble > previous_treble);
+			}
+			previous_bass = bass;
+			previous_treble = treble;
+		}
+
+		// The full compensation at the bottom, the shelves are not completely flat at the edges
+		CHECK_NEAR(previous_bass, loudness::BASS_DB_PER_STEP * LOUDNESS_REFERENCE_STEP, 0.5);
+		if (rate > 32000) {
+			CHECK_NEAR(previous_treble, loudness::TREBLE_DB_PER_STEP * LOUDNESS_REFERENCE_STEP, 0.5);
+		}
+	}
+
+	// Past the last step the table is clamped
+	eq::Bank<LOUDNESS_BANDS> clamped = loudness::get_bank(200, 44100);
+	eq::Bank<LOUDNESS_BANDS> last = loudness::get_bank(LOUDNESS_STEPS - 1, 44100);
+	CHECK(memcmp(&clamped, &last, sizeof(clamped)) == 0);
+}
+
+// Jumping from the reference to the bottom step crossfades, so the output can not move faster than the sine itself
+static void crossfade() {
+	const double frequency = 100;
+	const double amplitude = 8000;
+	const uint32_t rate = 44100;
+
+	dsp::Chain<loudness::Loudness> chain;
+	loudness::Loudness& stage = chain.get<loudness::Loudness>();
+	stage.set(loudness::get_bank(LOUDNESS_REFERENCE_STEP, rate));
+
+	uint32_t block[256];
+	int previous = 0;
+	int max_step = 0;
+	size_t t = 0;
+	for (int b = 0; b < 100; b++) {
+		if (b == 50) {
+			stage.set(loudness::get_bank(0, rate));
+			CHECK(stage.busy());
+		}
+
+		for (uint32_t& frame : block) {
+			int16_t sample = (int16_t)lrint(amplitude * sin(2 * M_PI * frequency * t++ / rate));
+			frame = (uint16_t)sample * 0x00010001u;
+		}
+		chain.process(block, 256);
+
+		for (uint32_t frame : block) {
+			int sample = (int16_t)frame;
+			if (b > 0) {
+				max_step = std::max(max_step, abs(sample - previous));
+			}
+			previous = sample;
+		}
+	}
+	CHECK(!stage.busy());
+
+	double slope = 2 * M_PI * frequency / rate * amplitude;
+	printf("largest step %d, the sine moves up to %.0f\n", max_step, slope);
+	CHECK(max_step < slope * 1.1);
+}
+
+int main() {
+	steps();
+	crossfade();
+	return result();
+}
@@ -0,0 +1,84 @@
+#include <cmath>
+#include <cstdio>
+
+#include "esp_timer.h"
+#include "meter.h"
+#include "test.h"
+
+// Built once with float and once with fixed point samples
+#define BLOCK 256
+
+static void play(dsp::Chain<meter::Meter>& chain, size_t blocks, int16_t (*left)(size_t), int16_t (*right)(size_t)) {
+	uint32_t frames[BLOCK];
+	for (size_t b = 0; b < blocks; b++) {
+		for (size_t i = 0; i < BLOCK; i++) {
+			size_t t = b * BLOCK + i;
+			frames[i] = (uint16_t)left(t) | ((uint32_t)(uint16_t)right(t) << 16);
+		}
+		chain.process(frames, BLOCK);
+		meter::publish(chain.get<meter::Meter>(), BLOCK);
+		stub_time_us += BLOCK * 1000000ll / 44100;
+	}
+}
+
+static int16_t sine(size_t t) {
+	return (int16_t)lrint(16384 * sin(2 * M_PI * t / 64));
+}
+
+static int16_t square(size_t t) {
+	return t & 1 ? 32767 : -32768;
+}
+
+static int16_t quiet(size_t t) {
+	return t & 1 ? 3 : -3;
+}
+
+static int16_t offset(size_t) {
+	return 328;
+}
+
+int main() {
+	dsp::Chain<meter::Meter> chain;
+
+	// Nothing played since boot counts as silent right away
+	stub_time_us = 1000;
+	CHECK(meter::silent());
+	CHECK(meter::get_snapshot().silent);
+
+	// Dither is not sound either
+	play(chain, 10, quiet, quiet);
+	CHECK(meter::silent());
+
+	play(chain, 100, sine, square);
+	CHECK(!meter::silent());
+
+	meter::Snapshot snapshot = meter::get_snapshot();
+	CHECK(snapshot.frames == 110 * BLOCK);
+	CHECK(!snapshot.silent);
+	CHECK(snapshot.silent_ms < 10);
+
+	// A sine at half scale is 3 dB below its peak, the full scale square wave hits the rail every frame
+	play(chain, 100, sine, square);
+	snapshot = meter::get_snapshot();
+	CHECK_NEAR(snapshot.left.peak_db, -6.02, 0.01);
+	CHECK_NEAR(snapshot.left.rms_db, -9.03, 0.01);
+	CHECK_NEAR(snapshot.left.dc, 0, 1e-4);
+	CHECK_NEAR(snapshot.right.rms_db, 0, 0.01);
+	CHECK(snapshot.right.clips == 200 * BLOCK);
+
+	// A quiet tone next to nothing else keeps its level, the sums do not drown it
+	play(chain, 100, quiet, offset);
+	snapshot = meter::get_snapshot();
+	CHECK_NEAR(snapshot.left.rms_db, 20 * log10(3 / 32768.), 0.01);
+	CHECK_NEAR(snapshot.right.dc, 328 / 32768., 1e-6);
+	// The clip counter keeps running
+	CHECK(snapshot.right.clips == 200 * BLOCK);
+
+	// Silent again once the timeout passed without sound
+	stub_time_us += (CONFIG_CAR_STEREO_SILENCE_TIMEOUT - 100) * 1000ll;
+	CHECK(!meter::silent());
+	stub_time_us += 200 * 1000;
+	CHECK(meter::silent());
+
+	return result();
+}
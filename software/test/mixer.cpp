@@ -0,0 +1,61 @@
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "mixer.h"
+#include "test.h"
+
+#define SAMPLE_RATE 44100
+#define LEVEL 1000
+
+static uint32_t frame(int16_t left, int16_t right) {
+	return (uint16_t)left | ((uint32_t)(uint16_t)right << 16);
+}
+
+// Queues a prompt of constant level, so every frame it reaches is easy to spot
+static mixer::Voice* prompt(size_t frames) {
+	mixer::Voice* voice = mixer::acquire(SAMPLE_RATE);
+	RingBuffer::Region region = mixer::reserve(voice, frames);
+	std::fill_n(region.first, region.first_length, frame(LEVEL, -LEVEL));
+	std::fill_n(region.second, region.second_length, frame(LEVEL, -LEVEL));
+	mixer::commit(voice, region.length());
+	return voice;
+}
+
+// Frames of the block that have the prompt in them
+static size_t mixed(const uint32_t* frames, size_t length) {
+	return std::count(frames, frames + length, frame(LEVEL, -LEVEL));
+}
+
+int main() {
+	// Blocks can be up to CONFIG_CAR_STEREO_BLOCK_FRAMES, the prompt has to reach the end of every one of them
+	static_assert(CONFIG_CAR_STEREO_BLOCK_FRAMES > 512);
+	for (size_t length : {256, 512, 768, CONFIG_CAR_STEREO_BLOCK_FRAMES}) {
+		mixer::Voice* voice = prompt(2 * CONFIG_CAR_STEREO_BLOCK_FRAMES);
+		CHECK(voice);
+
+		// The music is silent, so the ducking does not change what is mixed in
+		static uint32_t frames[CONFIG_CAR_STEREO_BLOCK_FRAMES];
+		std::fill_n(frames, length, 0);
+		mixer::process(frames, length, SAMPLE_RATE);
+		CHECK(mixer::active());
+		CHECK(frames[length - 1] == frame(LEVEL, -LEVEL));
+
+		size_t count = mixed(frames, length);
+		printf("block=%4zu: prompt in %zu frames\n", length, count);
+		// The resampler only takes a few frames to fill its history
+		CHECK(count + 16 >= length);
+
+		// Fades out over the next block and frees the voice
+		mixer::stop(voice);
+		std::fill_n(frames, length, 0);
+		mixer::process(frames, length, SAMPLE_RATE);
+		CHECK(std::abs((int16_t)frames[length - 1]) <= LEVEL / 64);
+
+		std::fill_n(frames, length, 0);
+		mixer::process(frames, length, SAMPLE_RATE);
+		CHECK(std::count(frames, frames + length, 0u) == (long)length);
+	}
+
+	return result();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The way the channels used to be handled, every frame split into a struct
+// Same as the naive versions in src/benchmark.cpp, the kernels are checked and timed against these
+namespace naive {
+	struct __attribute__((packed)) Frame {
+		int16_t channel1;
+		int16_t channel2;
+	};
+
+	inline void swap(uint32_t* frames, size_t length) {
+		Frame* frame = (Frame*)frames;
+		for (size_t i = 0; i < length; i++) {
+			int16_t temp = frame[i].channel1;
+			frame[i].channel1 = frame[i].channel2;
+			frame[i].channel2 = temp;
+		}
+	}
+
+	inline void downmix(uint32_t* frames, size_t length) {
+		Frame* frame = (Frame*)frames;
+		for (size_t i = 0; i < length; i++) {
+			int16_t mono = (frame[i].channel1 + frame[i].channel2) / 2;
+			frame[i].channel1 = mono;
+			frame[i].channel2 = mono;
+		}
+	}
+
+	inline void invert(uint32_t* frames, size_t length) {
+		Frame* frame = (Frame*)frames;
+		for (size_t i = 0; i < length; i++) {
+			frame[i].channel1 = -frame[i].channel1;
+			frame[i].channel2 = -frame[i].channel2;
+		}
+	}
+
+	inline void expand(const uint32_t* input, uint32_t* output, size_t length) {
+		const Frame* frame = (const Frame*)input;
+		int32_t* samples = (int32_t*)output;
+		for (size_t i = 0; i < length; i++) {
+			samples[2 * i] = frame[i].channel1 << 16;
+			samples[2 * i + 1] = frame[i].channel2 << 16;
+		}
+	}
+}
@@ -0,0 +1,167 @@
+#include <cstdlib>
+#include <vector>
+
+#include "rate_changes.h"
+#include "resampler.h"
+#include "test.h"
+
+#define BLOCK 256
+#define LEVEL 16000
+
+struct Segment {
+	uint32_t rate;
+	size_t frames;
+};
+
+struct Output {
+	int16_t left;
+	// Amount of reclocks before this frame went out
+	size_t clock;
+};
+
+// Odd segments are negative, so every frame tells which segment it came from
+static int16_t level(size_t segment) {
+	return segment % 2 ? -LEVEL : LEVEL;
+}
+
+// Runs the consumer in the same order as the i2s task: switch once nothing is left at the old rate, otherwise resample up to the change and fade
+static std::vector<Output> play(const std::vector<Segment>& segments, float ratio, std::vector<uint32_t>& reclocks) {
+	static uint32_t storage[16384];
+	RingBuffer audio(storage, 16384);
+	RateChanges changes;
+	Resampler resampler(Resampler::Quality::CUBIC);
+	RateFade fade;
+
+	// The first segment plays at the rate we start with
+	for (size_t s = 0; s < segments.size(); s++) {
+		if (s) {
+			CHECK(changes.push(audio.write_position(), segments[s].rate));
+		}
+
+		uint32_t frame = (uint16_t)level(s) | ((uint32_t)(uint16_t)(level(s) / 2) << 16);
+		for (size_t i = 0; i < segments[s].frames; i++) {
+			audio.write(&frame, 1);
+		}
+	}
+
+	std::vector<Output> output;
+	uint32_t block[BLOCK];
+	for (;;) {
+		size_t remaining = changes.remaining(audio.read_position());
+		if (!remaining) {
+			CHECK(changes.take(audio.read_position()) != 0);
+			reclocks.push_back(audio.read_position());
+			resampler.reset();
+			fade.restart();
+			continue;
+		}
+
+		resampler.set_ratio(ratio);
+		size_t frames = resampler.process(audio, block, BLOCK, remaining);
+		if (!frames) {
+			break;
+		}
+		fade.apply(block, frames, remaining, resampler.get_ratio());
+
+		for (size_t i = 0; i < frames; i++) {
+			output.push_back({(int16_t)block[i], reclocks.size()});
+		}
+	}
+
+	return output;
+}
+
+static void ordering(float ratio) {
+	std::vector<Segment> segments = {{44100, 1000}, {48000, 700}, {32000, 60}, {44100, 2000}, {48000, 500}};
+	std::vector<uint32_t> reclocks;
+	std::vector<Output> output = play(segments, ratio, reclocks);
+
+	// Every change happened exactly when the last frame at the old rate was read
+	CHECK(reclocks.size() == segments.size() - 1);
+	size_t position = 0;
+	for (size_t s = 0; s + 1 < segments.size() && s < reclocks.size(); s++) {
+		position += segments[s].frames;
+		CHECK(reclocks[s] == position);
+	}
+
+	// No frame plays at the clock of another segment
+	size_t wrong = 0;
+	for (const Output& o : output) {
+		wrong += o.left && (o.left > 0) != (level(o.clock) > 0);
+	}
+	CHECK(wrong == 0);
+
+	for (size_t clock = 0; clock < segments.size(); clock++) {
+		std::vector<int> magnitude;
+		for (const Output& o : output) {
+			if (o.clock == clock) {
+				magnitude.push_back(std::abs(o.left));
+			}
+		}
+		CHECK(!magnitude.empty());
+		if (magnitude.empty()) {
+			continue;
+		}
+
+		// Faded in from silence after a change, and out to silence in front of one
+		if (clock) {
+			CHECK(magnitude.front() == 0);
+		}
+		if (clock + 1 < segments.size()) {
+			CHECK(magnitude.back() <= LEVEL * ratio / RATE_FADE_FRAMES + 1);
+		}
+
+		// The segments that are longer than both fades reach full level and only ramp in between
+		if (magnitude.size() < 4 * RATE_FADE_FRAMES) {
+			continue;
+		}
+
+		bool rising = true;
+		for (size_t i = 1; clock && i < RATE_FADE_FRAMES; i++) {
+			rising &= magnitude[i] >= magnitude[i - 1];
+		}
+		CHECK(rising);
+
+		bool falling = true;
+		for (size_t i = magnitude.size() - RATE_FADE_FRAMES; clock + 1 < segments.size() && i < magnitude.size(); i++) {
+			falling &= magnitude[i] <= magnitude[i - 1];
+		}
+		CHECK(falling);
+
+		CHECK(magnitude[magnitude.size() / 2] == LEVEL);
+	}
+}
+
+static void capacity() {
+	RateChanges changes;
+	for (uint32_t i = 0; i < RATE_CHANGES; i++) {
+		CHECK(changes.push(i * 100, 44100));
+	}
+	// Full, the change is dropped instead of overwriting one that is pending
+	CHECK(!changes.push(1000, 48000));
+
+	CHECK(changes.remaining(0) == 0);
+	CHECK(changes.take(0) == 44100);
+	CHECK(changes.remaining(0) == 100);
+	CHECK(changes.take(99) == 0);
+	CHECK(changes.take(100) == 44100);
+}
+
+static void wrap() {
+	// The positions are free running counters, a change just past the wrap is still in the future
+	RateChanges changes;
+	CHECK(changes.push(10, 48000));
+	CHECK(changes.remaining(UINT32_MAX - 5) == 16);
+	CHECK(changes.take(UINT32_MAX - 5) == 0);
+	CHECK(changes.take(10) == 48000);
+	CHECK(changes.remaining(10) == SIZE_MAX);
+}
+
+int main() {
+	// At exactly the nominal rate and with the drift correction running
+	ordering(1.f);
+	ordering(1.0005f);
+	capacity();
+	wrap();
+	return result();
+}
@@ -0,0 +1,145 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+#include "resampler.h"
+#include "test.h"
+
+#define INPUT_RATE 44100.
+// Amount of output frames that are analysed, the start is skipped while the history fills up
+#define FRAMES 8192
+#define SKIP 64
+
+static uint32_t to_frame(int16_t left, int16_t right) {
+	return (uint16_t)left | ((uint32_t)(uint16_t)right << 16);
+}
+
+struct Quality {
+	// Level of everything that is not the tone, relative to the tone
+	double thd_n_db;
+	// Level of the tone relative to the input
+	double gain_db;
+};
+
+// Resamples a sine and fits a sine at the expected output frequency to what comes out, the residual is distortion and noise
+static Quality measure(Resampler::Quality quality, double ratio, double frequency, double amplitude = 16384) {
+	static uint32_t storage[4096];
+	RingBuffer input(storage, 4096);
+
+	Resampler resampler(quality);
+	resampler.set_bandwidth(Resampler::bandwidth_for(ratio));
+	resampler.set_ratio(ratio);
+
+	std::vector<uint32_t> output(FRAMES);
+	size_t produced = 0;
+	size_t n = 0;
+	while (produced < FRAMES) {
+		RingBuffer::Region region = input.reserve(input.space());
+		for (uint32_t* part : {region.first, region.second}) {
+			size_t length = part == region.first ? region.first_length : region.second_length;
+			for (size_t i = 0; i < length; i++, n++) {
+				double phase = 2 * M_PI * frequency * n / INPUT_RATE;
+				part[i] = to_frame(lrint(amplitude * sin(phase)), lrint(amplitude * cos(phase)));
+			}
+		}
+		input.commit(region.length());
+
+		produced += resampler.process(input, output.data() + produced, std::min<size_t>(256, FRAMES - produced));
+	}
+
+	// Least squares fit of a sin and cos at the output frequency, on the left channel
+	double omega = 2 * M_PI * frequency * ratio / INPUT_RATE;
+	double ss = 0, cc = 0, sc = 0, sy = 0, cy = 0;
+	for (size_t i = SKIP; i < FRAMES; i++) {
+		double s = sin(omega * i);
+		double c = cos(omega * i);
+		double y = (int16_t)output[i];
+		ss += s * s;
+		cc += c * c;
+		sc += s * c;
+		sy += s * y;
+		cy += c * y;
+	}
+	double det = ss * cc - sc * sc;
+	double a = (sy * cc - cy * sc) / det;
+	double b = (cy * ss - sy * sc) / det;
+
+	double residual = 0, signal = 0;
+	for (size_t i = SKIP; i < FRAMES; i++) {
+		double fit = a * sin(omega * i) + b * cos(omega * i);
+		double y = (int16_t)output[i];
+		residual += (y - fit) * (y - fit);
+		signal += fit * fit;
+	}
+
+	return {
+		.thd_n_db = 10 * log10(residual / signal),
+		.gain_db = 20 * log10(sqrt(a * a + b * b) / amplitude),
+	};
+}
+
+// The drift correction stays within a couple of thousand ppm of one, the default cubic interpolation has to be clean there
+static void drift_correction() {
+	for (double ppm : {-2000.0, -500.0, 50.0, 500.0, 2000.0}) {
+		double ratio = 1 + ppm * 1e-6;
+
+		Quality low = measure(Resampler::Quality::CUBIC, ratio, 1000);
+		Quality high = measure(Resampler::Quality::CUBIC, ratio, 5000);
+		printf("cubic at %5.0f ppm: 1 kHz %6.1f dB, 5 kHz %6.1f dB THD+N\n", ppm, low.thd_n_db, high.thd_n_db);
+
+		// A sine at -6 dBFS quantized to 16 bit is at about -90 dB
+		CHECK(low.thd_n_db < -80);
+		CHECK(high.thd_n_db < -40);
+		CHECK_NEAR(low.gain_db, 0, 0.01);
+		CHECK_NEAR(high.gain_db, 0, 0.05);
+	}
+}
+
+static const char* name(Resampler::Quality quality) {
+	switch (quality) {
+		case Resampler::Quality::LINEAR: return "linear";
+		case Resampler::Quality::CUBIC: return "cubic";
+		default: return "sinc";
+	}
+}
+
+// Compares the three qualities for the conversions the fixed output rate mode does
+static void conversion() {
+	const Resampler::Quality qualities[] = {Resampler::Quality::LINEAR, Resampler::Quality::CUBIC, Resampler::Quality::SINC};
+	const double frequencies[] = {1000, 5000, 10000};
+
+	for (double ratio : {44100. / 48000, 48000. / 44100, 32000. / 48000}) {
+		double previous[std::size(frequencies)] = {0, 0, 0};
+		for (Resampler::Quality quality : qualities) {
+			printf("%-6s ratio %.4f:", name(quality), ratio);
+			for (size_t f = 0; f < std::size(frequencies); f++) {
+				Quality q = measure(quality, ratio, frequencies[f]);
+				printf(" %5.0f Hz %6.1f dB (%5.2f dB)", frequencies[f], q.thd_n_db, q.gain_db);
+
+				// Every step up in quality is at least as clean
+				if (quality != Resampler::Quality::LINEAR) {
+					CHECK(q.thd_n_db <= previous[f] + 0.5);
+				}
+				previous[f] = q.thd_n_db;
+
+				if (quality == Resampler::Quality::SINC) {
+					// Flat and clean up to 10 kHz
+					CHECK(q.thd_n_db < -70);
+					CHECK_NEAR(q.gain_db, 0, 0.05);
+				} else if (quality == Resampler::Quality::CUBIC && frequencies[f] <= 5000) {
+					CHECK(q.thd_n_db < -40);
+				} else if (quality == Resampler::Quality::LINEAR && frequencies[f] <= 1000) {
+					CHECK(q.thd_n_db < -55);
+				}
+			}
+			printf("\n");
+		}
+	}
+}
+
+int main() {
+	drift_correction();
+	conversion();
+	return result();
+}
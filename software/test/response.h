@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cmath>
+#include <complex>
+
+#include "eq.h"
+
+// Frequency response of a bank of biquads, straight from the coefficients
+inline double to_double(dsp::Coefficient c) {
+#ifdef CONFIG_CAR_STEREO_DSP_FIXED_POINT
+	return (double)c / (1 << dsp::COEFFICIENT_SHIFT);
+#else
+	return c;
+#endif
+}
+
+template <size_t N>
+inline double response_db(const eq::Bank<N>& bank, double frequency, uint32_t sample_rate) {
+	std::complex<double> z = std::polar(1.0, -2 * M_PI * frequency / sample_rate);
+	std::complex<double> h = 1;
+	for (const eq::Coefficients& c : bank) {
+		h *= (to_double(c.b0) + to_double(c.b1) * z + to_double(c.b2) * z * z) / (1.0 + to_double(c.a1) * z + to_double(c.a2) * z * z);
+	}
+	return 20 * log10(std::abs(h));
+}
+
+// Both poles inside the unit circle
+inline bool stable(const eq::Coefficients& c) {
+	double a1 = to_double(c.a1);
+	double a2 = to_double(c.a2);
+	return fabs(a2) < 1 && fabs(a1) < 1 + a2;
+}
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "riff.h"
+#include "test.h"
+
+// Every case is copied into a buffer of its exact size, so the sanitizers catch reads past the end
+static riff::Wave parse(const std::vector<uint8_t>& bytes) {
+	uint8_t* copy = new uint8_t[bytes.size()];
+	std::copy(bytes.begin(), bytes.end(), copy);
+	riff::Wave wave = riff::parse(copy, bytes.size());
+
+	// Whatever was found has to lie within the input
+	if (wave.data) {
+		CHECK(wave.data >= copy && wave.data + wave.size <= copy + bytes.size());
+	}
+
+	delete[] copy;
+	return wave;
+}
+
+static void put_u16(std::vector<uint8_t>& bytes, uint16_t value) {
+	bytes.push_back(value);
+	bytes.push_back(value >> 8);
+}
+
+static void put_u32(std::vector<uint8_t>& bytes, uint32_t value) {
+	put_u16(bytes, value);
+	put_u16(bytes, value >> 16);
+}
+
+static void put_tag(std::vector<uint8_t>& bytes, const char (&tag)[5]) {
+	bytes.insert(bytes.end(), tag, tag + 4);
+}
+
+// 16 bit stereo PCM with the given amount of frames
+static std::vector<uint8_t> wave(uint32_t frames) {
+	std::vector<uint8_t> bytes;
+	put_tag(bytes, "RIFF");
+	put_u32(bytes, 4 + 8 + 16 + 8 + frames * 4);
+	put_tag(bytes, "WAVE");
+
+	put_tag(bytes, "fmt ");
+	put_u32(bytes, 16);
+	put_u16(bytes, riff::PCM);
+	put_u16(bytes, 2);
+	put_u32(bytes, 44100);
+	put_u32(bytes, 44100 * 4);
+	put_u16(bytes, 4);
+	put_u16(bytes, 16);
+
+	put_tag(bytes, "data");
+	put_u32(bytes, frames * 4);
+	bytes.resize(bytes.size() + frames * 4);
+	return bytes;
+}
+
+static void set_u32(std::vector<uint8_t>& bytes, size_t offset, uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		bytes[offset + i] = value >> (8 * i);
+	}
+}
+
+// The embedded assets are parsed at compile time, an out of bounds read there does not compile
+constexpr uint8_t EMPTY[] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E'};
+static_assert(!riff::parse(EMPTY, sizeof(EMPTY)).valid());
+
+static void valid() {
+	riff::Wave parsed = parse(wave(100));
+	CHECK(parsed.valid());
+	CHECK(parsed.samples == 100);
+	CHECK(parsed.format.sample_rate == 44100);
+}
+
+static void lying_riff_size() {
+	// Too small to even hold the form type
+	for (uint32_t size = 0; size < 4; size++) {
+		std::vector<uint8_t> bytes = wave(100);
+		set_u32(bytes, 4, size);
+		CHECK(!parse(bytes).valid());
+	}
+	std::vector<uint8_t> empty(EMPTY, EMPTY + sizeof(EMPTY));
+	CHECK(!parse(empty).valid());
+
+	// Only the form type, no chunks
+	std::vector<uint8_t> bytes = wave(100);
+	set_u32(bytes, 4, 4);
+	CHECK(!parse(bytes).valid());
+
+	// Larger than the file, gets clamped to what is there
+	bytes = wave(100);
+	set_u32(bytes, 4, 0xFFFFFFFF);
+	riff::Wave parsed = parse(bytes);
+	CHECK(parsed.valid());
+	CHECK(parsed.samples == 100);
+
+	// Ends in the middle of the data chunk, the rest of the file is ignored
+	bytes = wave(100);
+	set_u32(bytes, 4, 4 + 8 + 16 + 8 + 40);
+	parsed = parse(bytes);
+	CHECK(parsed.valid());
+	CHECK(parsed.samples == 10);
+}
+
+static void lying_chunk_size() {
+	// A data chunk larger than the file is truncated
+	std::vector<uint8_t> bytes = wave(100);
+	set_u32(bytes, 40, 0xFFFFFFFF);
+	riff::Wave parsed = parse(bytes);
+	CHECK(parsed.valid());
+	CHECK(parsed.samples == 100);
+
+	// A format chunk larger than the file swallows the data chunk
+	bytes = wave(100);
+	set_u32(bytes, 16, 0xFFFFFFFE);
+	CHECK(!parse(bytes).valid());
+
+	// A format chunk that is too small
+	bytes = wave(100);
+	set_u32(bytes, 16, 8);
+	CHECK(!parse(bytes).valid());
+}
+
+static void truncated() {
+	std::vector<uint8_t> bytes = wave(16);
+	for (size_t length = 0; length < bytes.size(); length++) {
+		std::vector<uint8_t> part(bytes.begin(), bytes.begin() + length);
+		riff::Wave parsed = parse(part);
+
+		// The data chunk starts at 44, anything before that is missing a chunk
+		CHECK(parsed.valid() == (length >= 44));
+		if (parsed.valid()) {
+			CHECK(parsed.samples == (length - 44) / 4);
+		}
+	}
+}
+
+int main() {
+	valid();
+	lying_riff_size();
+	lying_chunk_size();
+	truncated();
+	return result();
+}
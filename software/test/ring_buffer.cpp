@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "ring_buffer.h"
+#include "test.h"
+
+static void fill(uint32_t* frames, size_t length, uint32_t start) {
+	for (size_t i = 0; i < length; i++) {
+		frames[i] = start + i;
+	}
+}
+
+// Reads everything that is available, in as many regions as it takes
+static size_t drain(RingBuffer& buffer, uint32_t* out) {
+	size_t total = 0;
+	for (;;) {
+		const uint32_t* data;
+		size_t length = buffer.peek(&data);
+		if (!length) {
+			return total;
+		}
+		memcpy(out + total, data, length * sizeof(uint32_t));
+		buffer.release(length);
+		total += length;
+	}
+}
+
+static void wrap() {
+	static uint32_t storage[16];
+	RingBuffer buffer(storage, 16);
+
+	uint32_t frames[16];
+	uint32_t out[16];
+
+	// Move the positions to the middle, so the next reservation wraps
+	fill(frames, 10, 0);
+	CHECK(buffer.write(frames, 10) == 10);
+	CHECK(drain(buffer, out) == 10);
+
+	RingBuffer::Region region = buffer.reserve(12);
+	CHECK(region.first == storage + 10);
+	CHECK(region.first_length == 6);
+	CHECK(region.second == storage);
+	CHECK(region.second_length == 6);
+	fill(region.first, region.first_length, 100);
+	fill(region.second, region.second_length, 106);
+	buffer.commit(region.length());
+
+	CHECK(buffer.available() == 12);
+	CHECK(buffer.space() == 4);
+
+	// The consumer sees the part up to the end of the storage first
+	const uint32_t* data;
+	CHECK(buffer.peek(&data) == 6);
+	CHECK(data == storage + 10);
+
+	CHECK(drain(buffer, out) == 12);
+	for (uint32_t i = 0; i < 12; i++) {
+		CHECK(out[i] == 100 + i);
+	}
+	CHECK(buffer.available() == 0);
+}
+
+static void overflow_drop() {
+	static uint32_t storage[16];
+	RingBuffer buffer(storage, 16, RingBuffer::Overflow::DROP);
+
+	uint32_t frames[16];
+	fill(frames, 16, 0);
+	CHECK(buffer.write(frames, 12) == 12);
+
+	// Does not fit, so none of it is written
+	CHECK(buffer.write(frames, 5) == 0);
+	CHECK(buffer.available() == 12);
+
+	RingBuffer::Stats stats = buffer.get_stats();
+	CHECK(stats.overflows == 1);
+	CHECK(stats.dropped == 5);
+	CHECK(stats.written == 12);
+
+	// What does fit still goes in
+	CHECK(buffer.write(frames, 4) == 4);
+	CHECK(buffer.space() == 0);
+}
+
+static void overflow_truncate() {
+	static uint32_t storage[16];
+	RingBuffer buffer(storage, 16, RingBuffer::Overflow::TRUNCATE);
+
+	uint32_t frames[16];
+	fill(frames, 16, 0);
+	CHECK(buffer.write(frames, 12) == 12);
+	CHECK(buffer.write(frames, 10) == 4);
+
+	RingBuffer::Stats stats = buffer.get_stats();
+	CHECK(stats.overflows == 1);
+	CHECK(stats.dropped == 6);
+
+	// The start of the truncated write made it in
+	uint32_t out[16];
+	CHECK(drain(buffer, out) == 16);
+	for (uint32_t i = 0; i < 4; i++) {
+		CHECK(out[12 + i] == i);
+	}
+}
+
+static void peek_release() {
+	static uint32_t storage[16];
+	RingBuffer buffer(storage, 16);
+
+	const uint32_t* data;
+	CHECK(buffer.peek(&data) == 0);
+
+	uint32_t frames[8];
+	fill(frames, 8, 0);
+	buffer.write(frames, 8);
+
+	// Peeking does not consume anything
+	CHECK(buffer.peek(&data) == 8);
+	CHECK(buffer.peek(&data) == 8);
+	CHECK(data[0] == 0);
+
+	// A partial release moves the start of the next peek
+	buffer.release(3);
+	CHECK(buffer.peek(&data) == 5);
+	CHECK(data[0] == 3);
+	CHECK(buffer.get_stats().read == 3);
+
+	buffer.underrun();
+	CHECK(buffer.get_stats().underruns == 1);
+}
+
+// A producer and a consumer thread with sizes that do not divide the capacity, every frame has to arrive in order
+static void spsc() {
+	static uint32_t storage[1024];
+	RingBuffer buffer(storage, 1024);
+
+	const size_t PACKET = 100;
+	const size_t PACKETS = 100000;
+
+	std::thread producer([&] {
+		uint32_t packet[PACKET];
+		uint32_t next = 0;
+		for (size_t i = 0; i < PACKETS;) {
+			if (buffer.space() < PACKET) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			fill(packet, PACKET, next);
+			CHECK(buffer.write(packet, PACKET) == PACKET);
+			next += PACKET;
+			i++;
+		}
+	});
+
+	uint32_t expected = 0;
+	bool ordered = true;
+	while (expected < PACKET * PACKETS) {
+		const uint32_t* data;
+		size_t length = buffer.peek(&data);
+		if (!length) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Odd sized releases, so the consumer is never aligned with the producer
+		length = std::min<size_t>(length, 37);
+		for (size_t i = 0; i < length; i++) {
+			ordered &= data[i] == expected++;
+		}
+		buffer.release(length);
+	}
+	producer.join();
+
+	CHECK(ordered);
+	CHECK(buffer.get_stats().dropped == 0);
+}
+
+int main() {
+	wrap();
+	overflow_drop();
+	overflow_truncate();
+	peek_release();
+	spsc();
+	return result();
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+// Host stand in, the tests move the clock by hand
+inline int64_t stub_time_us = 0;
+
+inline int64_t esp_timer_get_time() {
+	return stub_time_us;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// Host stand in, only what the firmware sources under test use
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define configTICK_RATE_HZ 100
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)((ms) * configTICK_RATE_HZ / 1000))
+
+// The newlib locks come in through FreeRTOS on the ESP32 as well
+#include "sys/lock.h"
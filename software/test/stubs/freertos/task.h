@@ -0,0 +1,29 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+// Host stand in, tasks are not started, the tests call the task bodies themselves
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+// Notifications that were given since the test last cleared it
+inline uint32_t stub_notifications = 0;
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+	static int task;
+	if (handle) {
+		*handle = &task;
+	}
+	return pdPASS;
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t) {
+	stub_notifications++;
+	return pdPASS;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t) {
+	uint32_t taken = stub_notifications;
+	stub_notifications = clear ? 0 : taken;
+	return taken;
+}
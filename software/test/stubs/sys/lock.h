@@ -0,0 +1,14 @@
+#pragma once
+
+#include <mutex>
+
+// Host stand in for the newlib locks, _lock_acquire is not recursive on the ESP32 either so a nested acquire deadlocks here as well
+typedef std::mutex _lock_t;
+
+inline void _lock_acquire(_lock_t* lock) {
+	lock->lock();
+}
+
+inline void _lock_release(_lock_t* lock) {
+	lock->unlock();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdio>
+#include <cmath>
+
+// Minimal checks for the host tests, every failure is printed and the test exits non zero at the end
+static int failures = 0;
+
+#define CHECK(condition) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+		failures++; \
+	} \
+} while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) do { \
+	double v_ = (value); \
+	double e_ = (expected); \
+	if (!(std::fabs(v_ - e_) <= (tolerance))) { \
+		fprintf(stderr, "%s:%d: CHECK_NEAR(%s, %s, %s) failed: %g != %g\n", __FILE__, __LINE__, #value, #expected, #tolerance, v_, e_); \
+		failures++; \
+	} \
+} while (0)
+
+static inline int result() {
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
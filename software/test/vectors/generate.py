@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Regenerates the IMA-ADPCM test vectors with scripts/wav2adpcm.py.
+
+For every vector it writes:
+    <name>.wav          the 16 bit PCM input
+    <name>_adpcm.wav    the output of wav2adpcm.py
+    <name>.pcm          the samples the encoder reconstructed while encoding, interleaved little endian int16
+
+The decoder in the firmware has to reproduce <name>.pcm bit for bit, test/adpcm.cpp checks that.
+"""
+
+import math
+import os
+import random
+import struct
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SCRIPTS = os.path.join(HERE, "..", "..", "scripts")
+sys.path.insert(0, SCRIPTS)
+
+import wav2adpcm  # noqa: E402
+
+SAMPLE_RATE = 22050
+# Not a multiple of the block length, so the last block is padded and cut off by the fact chunk
+COUNT = 1234
+
+
+def chirp(count, amplitude):
+    # Sweeps up to the Nyquist frequency, so the step index has to follow fast changes
+    return [int(amplitude * math.sin(math.pi * n * n / (2 * count))) for n in range(count)]
+
+
+def noise(count, seed):
+    generator = random.Random(seed)
+    return [generator.randint(-32768, 32767) for _ in range(count)]
+
+
+def square(count, period):
+    # Full scale steps drive the predictor into the clamp
+    return [32767 if (n // period) % 2 else -32768 for n in range(count)]
+
+
+def write_wav(path, channels):
+    count = len(channels[0])
+    interleaved = [channel[n] for n in range(count) for channel in channels]
+    data = struct.pack(f"<{len(interleaved)}h", *interleaved)
+    block_align = 2 * len(channels)
+    fmt = struct.pack("<HHIIHH", 1, len(channels), SAMPLE_RATE, SAMPLE_RATE * block_align, block_align, 16)
+
+    body = b"WAVE" + b"fmt " + struct.pack("<I", len(fmt)) + fmt + b"data" + struct.pack("<I", len(data)) + data
+    with open(path, "wb") as f:
+        f.write(b"RIFF" + struct.pack("<I", len(body)) + body)
+
+
+def reconstruct(samples):
+    """Runs the encoder over one channel the same way wav2adpcm.encode does and keeps its predictor."""
+    block_samples = (wav2adpcm.CHANNEL_BLOCK_SIZE - 4) * 2 + 1
+
+    output = []
+    index = 0
+    for start in range(0, len(samples), block_samples):
+        block = samples[start:start + block_samples]
+        block += [0] * (block_samples - len(block))
+
+        predictor = block[0]
+        output.append(predictor)
+        for sample in block[1:]:
+            _, predictor, index = wav2adpcm.encode_sample(sample, predictor, index)
+            output.append(predictor)
+
+    return output[:len(samples)]
+
+
+def generate(name, channels):
+    source = os.path.join(HERE, f"{name}.wav")
+    write_wav(source, channels)
+    subprocess.run([sys.executable, os.path.join(SCRIPTS, "wav2adpcm.py"), source, os.path.join(HERE, f"{name}_adpcm.wav")], check=True)
+
+    decoded = [reconstruct(channel) for channel in channels]
+    interleaved = [channel[n] for n in range(COUNT) for channel in decoded]
+    with open(os.path.join(HERE, f"{name}.pcm"), "wb") as f:
+        f.write(struct.pack(f"<{len(interleaved)}h", *interleaved))
+
+
+def main():
+    generate("mono", [chirp(COUNT, 20000)])
+    generate("stereo", [noise(COUNT, 207), square(COUNT, 37)])
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,231 @@
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <algorithm>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "twai.h"
+#include "audio.h"
+#include "avrcp.h"
+#include "test.h"
+
+// Built once with and once without the hybrid volume
+// The volume controller is included, so the test can drive reconcile and reset the state between runs
+#include "../main/src/volume.cpp"
+
+// Roughly the timing of the real buttons
+#define PRESS_MS 50
+#define GAP_MS 50
+
+void audio::set_gain(float) {}
+void audio::set_radio_volume(uint8_t) {}
+void avrcp::set_volume(uint8_t) {}
+
+// Stands in for the transmit task and the radio, a press is reported back after a lag
+namespace radio {
+	struct Report {
+		int64_t at;
+		int32_t direction;
+	};
+
+	static int32_t queued = 0;
+	static bool pressing = false;
+	static int64_t press_end = 0;
+	static int64_t next_press = 0;
+	static std::deque<Report> reports;
+
+	static int level = 0;
+	static int lag_ms = 150;
+	// Every so many presses the radio misses one, zero for never
+	static int miss_every = 0;
+	static int presses = 0;
+	static int lowest = 0;
+	static int highest = 0;
+
+	static void reset(int start) {
+		queued = 0;
+		pressing = false;
+		press_end = 0;
+		next_press = 0;
+		reports.clear();
+		level = start;
+		presses = 0;
+		lowest = start;
+		highest = start;
+	}
+
+	static void move(int to) {
+		level = std::clamp(to, 0, 30);
+		lowest = std::min(lowest, level);
+		highest = std::max(highest, level);
+		volume_controller::set_from_radio(level);
+	}
+
+	static void tick(int64_t now) {
+		if (pressing && now >= press_end) {
+			pressing = false;
+			next_press = now + GAP_MS * 1000;
+		}
+
+		if (!pressing && queued && now >= next_press) {
+			int32_t direction = queued > 0 ? 1 : -1;
+			queued -= direction;
+			pressing = true;
+			press_end = now + PRESS_MS * 1000;
+
+			presses++;
+			if (!miss_every || presses % miss_every) {
+				reports.push_back({now + lag_ms * 1000, direction});
+			}
+		}
+
+		while (!reports.empty() && reports.front().at <= now) {
+			move(level + reports.front().direction);
+			reports.pop_front();
+		}
+	}
+}
+
+bool twai::step_volume(int32_t steps) {
+	radio::queued += steps;
+	return true;
+}
+
+int32_t twai::cancel_volume() {
+	int32_t dropped = radio::queued;
+	radio::queued = 0;
+	return dropped;
+}
+
+int32_t twai::get_pending_steps() {
+	return radio::queued;
+}
+
+bool twai::volume_idle() {
+	return !radio::queued && !radio::pressing;
+}
+
+static int target() {
+#ifdef CONFIG_CAR_STEREO_HYBRID_VOLUME
+	return to_radio_volume_target(volume);
+#else
+	return to_radio_volume(volume);
+#endif
+}
+
+struct Event {
+	int64_t ms;
+	// The phone changes the volume, or the knob is turned by this many steps
+	int phone;
+	int knob;
+};
+
+// Runs the controller task and the radio in steps of a millisecond
+static void simulate(int start, int phone, std::initializer_list<Event> events = {}, int64_t seconds = 20) {
+	stub_time_us = 0;
+	stub_notifications = 0;
+	radio::reset(start);
+	synced = true;
+	rising = 0;
+	falling = 0;
+	stats = {};
+
+	volume_controller::set_from_radio(start);
+	volume_controller::set_from_remote(phone);
+
+	int64_t poll = 0;
+	for (int64_t ms = 0; ms < seconds * 1000; ms++) {
+		stub_time_us = ms * 1000;
+		for (const Event& event : events) {
+			if (event.ms != ms) {
+				continue;
+			}
+			if (event.knob) {
+				radio::move(radio::level + event.knob);
+			} else {
+				volume_controller::set_from_remote(event.phone);
+			}
+		}
+
+		radio::tick(stub_time_us);
+
+		if (ulTaskNotifyTake(pdTRUE, 0) || ms >= poll) {
+			TickType_t wait = reconcile();
+			poll = wait == portMAX_DELAY ? INT64_MAX : ms + wait * portTICK_PERIOD_MS;
+		}
+	}
+}
+
+// Reaches the target with exactly the steps it needs, however late the radio reports them
+static void straight(int start, int phone) {
+	simulate(start, phone);
+	printf("start=%2d phone=%3d: radio=%2d target=%2d presses=%d in %u ms\n",
+			start, phone, radio::level, target(), radio::presses, (unsigned)stats.last_ms);
+
+	CHECK(synced);
+	CHECK(radio::level == target());
+	CHECK(radio::presses == std::abs(target() - start));
+	CHECK(radio::lowest == std::min(start, target()));
+	CHECK(radio::highest == std::max(start, target()));
+	CHECK(stats.lost == 0);
+}
+
+int main() {
+	volume_controller::init();
+
+	// Every phone volume maps onto the radio and every radio step maps back onto the same step
+	bool reached[31] = {};
+	for (int v = 0; v <= 127; v++) {
+		volume = v;
+		CHECK(target() >= 0 && target() <= 30);
+		reached[target()] = true;
+	}
+	for (int r = 0; r <= 30; r++) {
+		CHECK(reached[r]);
+
+		synced = true;
+		radio_volume = 0;
+		volume_controller::set_from_radio(r);
+		CHECK(target() == r);
+	}
+
+	straight(0, 127);
+	straight(30, 0);
+	straight(10, 40);
+	straight(20, 60);
+
+	radio::lag_ms = 400;
+	straight(0, 127);
+	radio::lag_ms = 150;
+
+	// The phone changes direction halfway, the old steps are dropped instead of played out
+	simulate(0, 127, {{1000, 20, 0}});
+	CHECK(synced);
+	CHECK(radio::level == target());
+	CHECK(radio::presses <= 2 * radio::highest - target());
+
+	simulate(0, 20, {{1000, 127, 0}});
+	CHECK(synced);
+	CHECK(radio::level == target());
+	CHECK(radio::highest == target());
+
+	// Missed presses time out and are asked for again
+	radio::miss_every = 7;
+	simulate(0, 127);
+	radio::miss_every = 0;
+	CHECK(synced);
+	CHECK(radio::level == target());
+	CHECK(stats.lost > 0);
+	CHECK(radio::presses == target() + (int)stats.lost);
+
+	// Turning the knob against the sync gives up on it and leaves the radio where it is
+	simulate(0, 127, {{800, 0, -3}});
+	CHECK(synced);
+	CHECK(stats.interrupted == 1);
+	CHECK(radio::queued == 0);
+	CHECK(radio::level < 30);
+
+	return result();
+}